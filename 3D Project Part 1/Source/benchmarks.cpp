@@ -0,0 +1,412 @@
+#include "benchmarks.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#include "GLM/glm.hpp"
+#include "GLM/gtc/constants.hpp"
+#include "mesh_generation.h"
+#include "opengl_utilities.h"
+
+/* Benchmarks */
+
+// Best wall time of repeats runs, in milliseconds. The best run is the one
+// least disturbed by the rest of the system.
+template <typename Run>
+static double MeasureBest(int repeats, const Run& run)
+{
+	double best = HUGE_VAL;
+	for (int i = 0; i < repeats; ++i)
+	{
+		auto start = std::chrono::steady_clock::now();
+		run();
+		auto end = std::chrono::steady_clock::now();
+		best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+	}
+	return best;
+}
+
+// Best time of repeats draws of the bound VAO, waiting for each to finish
+static double MeasureBestDraw(int repeats, int draws, const VAO& vao)
+{
+	glFinish();
+	return MeasureBest(repeats, [&]()
+	{
+		for (int i = 0; i < draws; ++i)
+			DrawVAO(vao);
+		glFinish();
+	});
+}
+
+// Vertices moved past the right of clip space, so every primitive is culled
+// and the draws time vertex fetch, the vertex shader and primitive assembly
+// without the rasterizer. Reads two or four attributes so none is optimized
+// out.
+static const char* culled_vertex_shader_source = R"VERTEX(
+#version 330 core
+
+layout(location = 0) in vec3 a_position;
+layout(location = 1) in vec3 a_normal;
+
+void main()
+{
+	gl_Position = vec4(a_position + a_normal, 1) + vec4(4, 4, 0, 0);
+	gl_PointSize = 1;
+}
+)VERTEX";
+
+static const char* culled_attributes_vertex_shader_source = R"VERTEX(
+#version 330 core
+
+layout(location = 0) in vec3 a_position;
+layout(location = 1) in vec3 a_normal;
+layout(location = 2) in vec2 a_uv;
+layout(location = 3) in vec4 a_color;
+
+void main()
+{
+	gl_Position = vec4(a_position + a_normal + a_color.rgb, a_uv.x + a_uv.y) + vec4(4, 4, 0, 0);
+	gl_PointSize = 1;
+}
+)VERTEX";
+
+static const char* culled_fragment_shader_source = R"FRAGMENT(
+#version 330 core
+
+out vec4 color;
+
+void main()
+{
+	color = vec4(1);
+}
+)FRAGMENT";
+
+/* Inlined Generators */
+
+// ParametricSpikes, defined here so the callables can inline it, and under
+// another address so the function pointer overloads don't swap in its batch
+// version and really call it once per sample
+static glm::dvec2 BenchmarkSpikes(double t)
+{
+	t = (t - 0.5) * glm::two_pi<double>();
+	double a = 2 + 4 * 2;
+	return glm::dvec2(std::cos(t) + std::sin(a * t) / a, std::sin(t) + std::cos(a * t) / a) * 0.3 + glm::dvec2(0.7, 0);
+}
+
+static glm::dvec3 BenchmarkTorus(double u, double v)
+{
+	double a = u * glm::two_pi<double>();
+	double b = v * glm::two_pi<double>();
+	double radius = 0.7 + 0.3 * std::cos(b);
+	return glm::dvec3(radius * std::cos(a), 0.3 * std::sin(b), radius * std::sin(a));
+}
+
+// The same surfaces through the function pointer overloads, an indirect call
+// per sample, and as callables the sampling loop can inline
+static void BenchmarkInlinedGenerators()
+{
+	std::cout << "Generators, function pointer vs inlined callable (ms, best of 5)" << std::endl;
+
+	auto spikes = [](double t)
+	{
+		return BenchmarkSpikes(t);
+	};
+	auto torus = [](double u, double v)
+	{
+		return BenchmarkTorus(u, v);
+	};
+
+	std::vector<glm::vec3> positions, normals;
+	std::vector<GLuint> indices;
+	ParametricSampleGrid grid;
+	auto Clear = [&]()
+	{
+		positions.clear();
+		normals.clear();
+		indices.clear();
+	};
+
+	for (int segments : { 160, 1024 })
+	{
+		double line_pointer = MeasureBest(5, [&]()
+		{
+			Clear();
+			GenerateParametricShapeFrom2D(positions, normals, indices, &BenchmarkSpikes, segments, segments, true);
+		});
+		double line_callable = MeasureBest(5, [&]()
+		{
+			Clear();
+			GenerateParametricShapeFrom2D(positions, normals, indices, spikes, segments, segments, true, grid);
+		});
+		double surface_pointer = MeasureBest(5, [&]()
+		{
+			Clear();
+			GenerateParametricShapeFrom3D(positions, normals, indices, &BenchmarkTorus, segments, segments);
+		});
+		double surface_callable = MeasureBest(5, [&]()
+		{
+			Clear();
+			GenerateParametricShapeFrom3D(positions, normals, indices, torus, segments, segments, grid);
+		});
+
+		std::cout << std::fixed << std::setprecision(2)
+			<< "  " << segments << "x" << segments
+			<< "  2D pointer " << line_pointer << "  callable " << line_callable
+			<< "  3D pointer " << surface_pointer << "  callable " << surface_callable << std::endl;
+	}
+}
+
+/* Parallel Generation */
+
+// The spikes mesh with squiggle on powers of two of threads up to the
+// hardware's (and at least 4), the speedup taken against one thread. Each run
+// is compared with the serial mesh as well, as the threads must not change a
+// bit of it.
+static void BenchmarkParallelGeneration()
+{
+	unsigned hardware_threads = std::max(std::thread::hardware_concurrency(), 1u);
+	std::cout << "Parallel generation, " << hardware_threads << " hardware threads (ms, best of 3)" << std::endl;
+
+	std::vector<unsigned> thread_counts;
+	for (unsigned threads = 1; threads < std::max(hardware_threads, 4u); threads *= 2)
+		thread_counts.push_back(threads);
+	thread_counts.push_back(std::max(hardware_threads, 4u));
+
+	std::vector<glm::vec3> serial_positions, serial_normals, positions, normals;
+	std::vector<GLuint> serial_indices, indices;
+	ParametricSampleGrid grid;
+
+	for (int segments : { 160, 2048 })
+	{
+		serial_positions.clear();
+		serial_normals.clear();
+		serial_indices.clear();
+		GenerateParametricShapeFrom2D(serial_positions, serial_normals, serial_indices, ParametricSpikes, segments, segments, true, grid);
+
+		double serial_time = 0;
+		for (unsigned threads : thread_counts)
+		{
+			ParametricShapeOptions options;
+			options.thread_count = threads;
+			double time = MeasureBest(3, [&]()
+			{
+				positions.clear();
+				normals.clear();
+				indices.clear();
+				GenerateParametricShapeFrom2D(positions, normals, indices, ParametricSpikes, segments, segments, true, grid, options);
+			});
+			if (threads == 1)
+				serial_time = time;
+
+			bool identical = positions.size() == serial_positions.size()
+				&& std::memcmp(positions.data(), serial_positions.data(), positions.size() * sizeof(glm::vec3)) == 0
+				&& std::memcmp(normals.data(), serial_normals.data(), normals.size() * sizeof(glm::vec3)) == 0
+				&& indices == serial_indices;
+
+			std::cout << std::fixed << std::setprecision(2)
+				<< "  " << segments << "x" << segments << "  " << threads << " threads " << time
+				<< "  speedup " << serial_time / time << (identical ? "" : "  OUTPUT DIFFERS") << std::endl;
+		}
+	}
+}
+
+/* Batch Profiles */
+
+// The scalar profiles against their SSE2/AVX2 batch kernels, over a grid
+// column's worth of parameters at a time as the sample grid calls them
+static void BenchmarkParametricLineBatches()
+{
+	std::cout << "Profiles, scalar vs batch (million evaluations/s, best of 5)" << std::endl;
+
+	const size_t count = 1 << 16;
+	std::vector<double> t(count);
+	std::vector<float> float_t(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		t[i] = -0.1 + 1.2 * i / (count - 1);
+		float_t[i] = float(t[i]);
+	}
+	std::vector<glm::dvec2> values(count);
+	std::vector<glm::vec2> float_values(count);
+
+	glm::dvec2(*const profiles[])(double) = {ParametricHalfSquiggle, ParametricHalfCircle, ParametricCircle, ParametricSpikes};
+	for (auto parametric_line : profiles)
+	{
+		auto batch = FindParametricLineBatch<double>(parametric_line);
+		auto float_batch = FindParametricLineBatch<float>(parametric_line);
+
+		double scalar_time = MeasureBest(5, [&]()
+		{
+			for (size_t i = 0; i < count; ++i)
+				values[i] = parametric_line(t[i]);
+		});
+		double batch_time = MeasureBest(5, [&]() { batch(t.data(), values.data(), count); });
+		double float_batch_time = MeasureBest(5, [&]() { float_batch(float_t.data(), float_values.data(), count); });
+
+		std::cout << std::fixed << std::setprecision(1)
+			<< "  " << std::setw(13) << std::left << FindParametricLineName(parametric_line) << std::right
+			<< "  scalar " << count / scalar_time / 1000
+			<< "  double batch " << count / batch_time / 1000
+			<< "  float batch " << count / float_batch_time / 1000 << std::endl;
+	}
+}
+
+/* Index Formats */
+
+// Replaces the VAO's 16-bit index buffer with the same indices at 32 bits, to
+// time what narrowing them saves. Restart indices are the 32-bit ones already.
+static void WidenIndices(VAO& vao, const std::vector<GLuint>& indices)
+{
+	glBindVertexArray(vao.id);
+	glDeleteBuffers(1, &vao.element_array_buffer);
+	glGenBuffers(1, &vao.element_array_buffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vao.element_array_buffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+	glBindVertexArray(0);
+	vao.element_array_type = GL_UNSIGNED_INT;
+}
+
+// The 160x160 spikes mesh of the scenes as a triangle list and as strips, with
+// 16 and 32-bit indices, drawn 20 times a run
+static void BenchmarkIndexFormats()
+{
+	std::cout << "Index formats, 160x160 spikes (million triangles/s, best of 5)" << std::endl;
+
+	Program program = CreateProgramFromSources(culled_vertex_shader_source, culled_fragment_shader_source);
+	if (program.id == 0)
+		return;
+	glUseProgram(program.id);
+
+	const int draws = 20;
+	ParametricSampleGrid grid;
+	for (auto topology : { ParametricTopology::TriangleList, ParametricTopology::TriangleStrip })
+	{
+		std::vector<glm::vec3> positions, normals;
+		std::vector<GLuint> indices;
+		ParametricShapeOptions options;
+		options.topology = topology;
+		GenerateParametricShapeFrom2D(positions, normals, indices, ParametricSpikes, 160, 160, true, grid, options);
+		size_t triangle_count = size_t(grid.layout.IndexCount() / 3);
+		GLenum primitive_mode = topology == ParametricTopology::TriangleStrip ? GL_TRIANGLE_STRIP : GL_TRIANGLES;
+
+		for (bool wide : { false, true })
+		{
+			VAO vao(positions, normals, indices, VertexFormat::Float, primitive_mode);
+			if (wide)
+				WidenIndices(vao, indices);
+			BindVAO(vao, program);
+			double time = MeasureBestDraw(5, draws, vao);
+			size_t index_size = vao.element_array_type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+
+			std::cout << std::fixed << std::setprecision(1)
+				<< "  " << (topology == ParametricTopology::TriangleStrip ? "strip" : "list ")
+				<< "  " << index_size * 8 << "-bit  " << std::setw(7) << indices.size() << " indices "
+				<< std::setw(6) << indices.size() * index_size / 1024. << " KiB  "
+				<< triangle_count * draws / time / 1000 << std::endl;
+
+			glBindVertexArray(0);
+			DeleteVAO(vao);
+		}
+	}
+
+	glUseProgram(0);
+	glDeleteProgram(program.id);
+}
+
+/* Vertex Layouts */
+
+static VertexAttribute MakeAttribute(GLuint location, GLint component_count, GLenum type, GLboolean normalized, GLuint stream)
+{
+	VertexAttribute attribute = { location, component_count, type, normalized, stream };
+	return attribute;
+}
+
+// 4M random points drawn once each, in order and shuffled: the mesh layouts in
+// both vertex formats, then position, normal, texture coordinates and a color
+// with a stream per attribute, in one stream, and with the position apart
+static void BenchmarkVertexLayouts()
+{
+	std::cout << "Vertex layouts, 4M points (million vertices/s, best of 5)" << std::endl;
+
+	Program program = CreateProgramFromSources(culled_vertex_shader_source, culled_fragment_shader_source);
+	Program attributes_program = CreateProgramFromSources(culled_attributes_vertex_shader_source, culled_fragment_shader_source);
+	if (program.id == 0 || attributes_program.id == 0)
+		return;
+
+	const GLsizei vertex_count = 1 << 22;
+	std::mt19937 random(21);
+	std::uniform_real_distribution<float> distribution(-1, 1);
+	std::vector<glm::vec3> positions(vertex_count), normals(vertex_count);
+	std::vector<glm::vec2> uvs(vertex_count);
+	std::vector<glm::u8vec4> colors(vertex_count);
+	for (GLsizei i = 0; i < vertex_count; ++i)
+	{
+		positions[i] = glm::vec3(distribution(random), distribution(random), distribution(random));
+		normals[i] = glm::normalize(glm::vec3(distribution(random), distribution(random), distribution(random)) + 0.01f);
+		uvs[i] = glm::vec2(distribution(random), distribution(random));
+		colors[i] = glm::u8vec4(random(), random(), random(), random());
+	}
+	const void* attribute_data[] = { positions.data(), normals.data(), uvs.data(), colors.data() };
+
+	std::vector<GLuint> sequential(vertex_count), shuffled;
+	for (GLsizei i = 0; i < vertex_count; ++i)
+		sequential[i] = i;
+	shuffled = sequential;
+	std::shuffle(shuffled.begin(), shuffled.end(), random);
+
+	const char* attribute_layout_names[] = { "separate", "interleaved", "mixed" };
+	VertexLayout attribute_layouts[3];
+	attribute_layouts[0].attributes = { MakeAttribute(0, 3, GL_FLOAT, GL_FALSE, 0), MakeAttribute(1, 3, GL_FLOAT, GL_FALSE, 1), MakeAttribute(2, 2, GL_FLOAT, GL_FALSE, 2), MakeAttribute(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, 3) };
+	attribute_layouts[1].attributes = { MakeAttribute(0, 3, GL_FLOAT, GL_FALSE, 0), MakeAttribute(1, 3, GL_FLOAT, GL_FALSE, 0), MakeAttribute(2, 2, GL_FLOAT, GL_FALSE, 0), MakeAttribute(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, 0) };
+	attribute_layouts[2].attributes = { MakeAttribute(0, 3, GL_FLOAT, GL_FALSE, 0), MakeAttribute(1, 3, GL_FLOAT, GL_FALSE, 1), MakeAttribute(2, 2, GL_FLOAT, GL_FALSE, 1), MakeAttribute(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, 1) };
+
+	auto Print = [&](const std::string& name, VAO& vao, const Program& vao_program)
+	{
+		glUseProgram(vao_program.id);
+		BindVAO(vao, vao_program);
+		double time = MeasureBestDraw(5, 1, vao);
+		std::cout << std::fixed << std::setprecision(1)
+			<< "  " << std::setw(36) << std::left << name << std::right << vertex_count / time / 1000 << std::endl;
+		glBindVertexArray(0);
+		DeleteVAO(vao);
+	};
+
+	for (bool shuffle : { false, true })
+	{
+		const std::vector<GLuint>& indices = shuffle ? shuffled : sequential;
+		std::string order = shuffle ? "shuffled" : "sequential";
+
+		for (VertexFormat vertex_format : { VertexFormat::Float, VertexFormat::Compressed })
+			for (VertexStreams vertex_streams : { VertexStreams::Separate, VertexStreams::Interleaved })
+			{
+				VAO vao(positions, normals, indices, vertex_format, GL_POINTS, vertex_streams);
+				Print(order + (vertex_format == VertexFormat::Float ? " float " : " compressed ")
+					+ (vertex_streams == VertexStreams::Separate ? "separate" : "interleaved"), vao, program);
+			}
+
+		for (int layout = 0; layout < 3; ++layout)
+		{
+			VAO vao(attribute_layouts[layout], vertex_count, attribute_data, indices, GL_POINTS);
+			Print(order + " 4 attributes " + attribute_layout_names[layout], vao, attributes_program);
+		}
+	}
+
+	glUseProgram(0);
+	glDeleteProgram(program.id);
+	glDeleteProgram(attributes_program.id);
+}
+
+void RunBenchmarks()
+{
+	BenchmarkInlinedGenerators();
+	BenchmarkParallelGeneration();
+	BenchmarkParametricLineBatches();
+	BenchmarkIndexFormats();
+	BenchmarkVertexLayouts();
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+/* Benchmarks */
+
+// The measurements behind the generator and draw path choices, run by
+// starting the program with --benchmark. Each prints a small table of best-of
+// timings to the console. Build in Release: the Debug runtime checks swamp
+// what is being measured. Needs the program's GL context to be current.
+void RunBenchmarks();
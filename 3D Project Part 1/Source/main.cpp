@@ -1,4 +1,6 @@
+#include <cstring>
 #include <iostream>
+#include <string>
 #include <vector>
 
 #include "GLM/glm.hpp"
@@ -9,6 +11,15 @@
 #include "GLFW/glfw3.h"
 #include "opengl_utilities.h"
 #include "mesh_generation.h"
+#include "mesh_optimization.h"
+#include "mesh_lod.h"
+#include "mesh_cache.h"
+#include "mesh_registry.h"
+#include "procedural_shapes.h"
+#include "stream_buffer.h"
+#include "uniform_blocks.h"
+#include "benchmarks.h"
+#include "tests.h"
 
 /* Keep the global state inside this struct */
 static struct {
@@ -17,6 +28,101 @@ static struct {
 	GLfloat key;
 } Globals;
 
+/* Shaders */
+
+// Shared by every program; u_position_scale / u_position_offset dequantize
+// compressed positions. The uniforms are in the blocks of uniform_blocks.h,
+// inserted after the #version line of every shader.
+//
+// u_squiggle is (frequency, amplitude, phase, scale) of a ParametricSquiggle
+// displacing an unsquiggled surface of revolution, the default leaving the
+// mesh as it is. With P = s(a) B for the azimuth a of the base position B and
+// meridian tangent T, the normal is s |B.xz| N + s'(a) (B x T). Vertices on
+// the axis have no azimuth and take the plain scale.
+static const std::string mesh_vertex_shader_source = WithUniformBlocks(R"VERTEX(
+#version 330 core
+
+layout(location = 0) in vec3 a_position;
+layout(location = 1) in vec3 a_normal;
+
+out vec3 vertex_position;
+out vec3 vertex_normal;
+
+void main()
+{
+	vec3 position = a_position * u_position_scale + u_position_offset;
+	vec3 normal = a_normal;
+
+	float radius = length(position.xz);
+	float scale = u_squiggle.w;
+	if (radius > 1e-6 * length(position))
+	{
+		float wave = u_squiggle.x * atan(-position.z, position.x) + u_squiggle.z;
+		scale = u_squiggle.w * (1 + u_squiggle.y * sin(wave));
+		float scale_derivative = u_squiggle.w * u_squiggle.y * u_squiggle.x * cos(wave);
+
+		vec3 azimuth = vec3(position.z, 0, -position.x) / radius;
+		vec3 meridian = cross(normal, azimuth);
+		normal = scale * radius * normal + scale_derivative * cross(position, meridian);
+	}
+	position *= scale;
+
+	gl_Position = u_transform * vec4(position, 1);
+	vertex_normal = vec3(u_transform * vec4(normalize(normal), 0));
+	vertex_position = vec3(gl_Position);
+}
+)VERTEX");
+
+// Lit by the frame's light and one that follows the mouse; shared by the
+// mesh and procedural color programs
+static const std::string color_fragment_shader_source = WithUniformBlocks(R"FRAGMENT(
+#version 330 core
+
+in vec3 vertex_position;
+in vec3 vertex_normal;
+
+out vec4 out_color;
+
+void main()
+{
+	vec3 color = vec3(0);
+
+	vec3 surface_color = u_color;
+	vec3 surface_position = vertex_position;
+	vec3 surface_normal = normalize(vertex_normal);
+
+	vec3 ambient_color = u_ambient_color;
+	color += ambient_color * surface_color;
+
+	vec3 light_direction = normalize(u_light_direction);
+	vec3 to_light = -normalize(light_direction);
+	vec3 light_color = u_light_color;
+
+	float diffuse_intensity = max(0, dot(to_light, surface_normal));
+	color += diffuse_intensity * light_color * surface_color;
+
+	vec3 view_dir = normalize(vec3(0, 0, -1));	
+	vec3 halfway_dir = normalize(view_dir + to_light);
+	float specular_intensity = max(0, dot(halfway_dir, surface_normal));
+	float shiny = u_shininess;
+	color += pow(specular_intensity, shiny) * light_color;
+
+	vec3 light_direction2 = normalize(vec3(-u_mouse_position, 2));
+	vec3 to_light2 = -normalize(light_direction2);
+	vec3 light_color2 =  vec3(0.5);
+
+	float diffuse_intensity2 = max(0, dot(to_light2, surface_normal));
+	color += diffuse_intensity2 * light_color2 * surface_color;
+
+	vec3 halfway_dir2 = normalize(view_dir + to_light2);
+	float specular_intensity2 = max(0, dot(halfway_dir2, surface_normal));
+	shiny = u_shininess;
+	color += pow(specular_intensity2, shiny) * light_color2;
+
+	out_color = vec4(color, 1);
+}
+)FRAGMENT");
+
 /* GLFW Callback functions */
 static void ErrorCallback(int error, const char* description)
 {
@@ -43,6 +149,23 @@ static void keyPressedCallback(GLFWwindow* window, int key, int scancode, int ac
 
 int main(int argc, char* argv[])
 {
+	// --statistics prints how the meshes were made and shared once they are,
+	// and how much the frames streamed at exit. --benchmark runs the
+	// measurements of benchmarks.h in a hidden window instead of the scenes,
+	// --test the checks of tests.h, exiting with 1 when one fails.
+	bool print_statistics = false;
+	bool run_benchmarks = false;
+	bool run_tests = false;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--statistics") == 0)
+			print_statistics = true;
+		else if (strcmp(argv[i], "--benchmark") == 0)
+			run_benchmarks = true;
+		else if (strcmp(argv[i], "--test") == 0)
+			run_tests = true;
+	}
+
 	/* Set GLFW error callback */
 	glfwSetErrorCallback(ErrorCallback);
 
@@ -54,17 +177,28 @@ int main(int argc, char* argv[])
 	}
 
 	/* Create a windowed mode window and its OpenGL context */
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	// 4.0 for the tessellated shapes where the driver has it, else 3.3
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE);
 	glfwWindowHint(GLFW_TRANSPARENT_FRAMEBUFFER, GLFW_TRUE);
 	glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+	glfwWindowHint(GLFW_VISIBLE, run_benchmarks || run_tests ? GLFW_FALSE : GLFW_TRUE);
 	GLFWwindow* window = glfwCreateWindow(
 		Globals.screen_dimensions.x, Globals.screen_dimensions.y,
 		"Ranem Elshanawany", NULL, NULL
 	);
 	if (!window)
+	{
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+		window = glfwCreateWindow(
+			Globals.screen_dimensions.x, Globals.screen_dimensions.y,
+			"Ranem Elshanawany", NULL, NULL
+		);
+	}
+	if (!window)
 	{
 		std::cout << "Failed to create GLFW window" << std::endl;
 		glfwTerminate();
@@ -85,6 +219,19 @@ int main(int argc, char* argv[])
 		return -1;
 	}
 
+	if (run_benchmarks)
+	{
+		RunBenchmarks();
+		glfwTerminate();
+		return 0;
+	}
+	if (run_tests)
+	{
+		bool passed = RunTests();
+		glfwTerminate();
+		return passed ? 0 : 1;
+	}
+
 	/* Set GLFW Callbacks */
 	glfwSetCursorPosCallback(window, CursorPositionCallback);
 	glfwSetWindowSizeCallback(window, WindowSizeCallback);
@@ -94,65 +241,13 @@ int main(int argc, char* argv[])
 	glClearColor(0, 0, 0, 1);
 	glEnable(GL_DEPTH_TEST);
 
-	/* Creating Meshes */
-	std::vector<glm::vec3> positions;
-	std::vector<glm::vec3> normals;
-	std::vector<GLuint> indicies;
-	GenerateParametricShapeFrom2D(positions, normals, indicies, ParametricHalfCircle, 16, 16, false);
-	VAO sphereVAO(positions, normals, indicies);
-
-	positions.clear();
-	normals.clear();
-	indicies.clear();
-	GenerateParametricShapeFrom2D(positions, normals, indicies, ParametricCircle, 16, 16, false);
-	VAO torusVAO(positions, normals, indicies);
-
-	positions.clear();
-	normals.clear();
-	indicies.clear();
-	GenerateParametricShapeFrom2D(positions, normals, indicies, ParametricHalfSquiggle, 160, 160, true);
-	VAO sqiggleVAO(positions, normals, indicies);
-
-	positions.clear();
-	normals.clear();
-	indicies.clear();
-	GenerateParametricShapeFrom2D(positions, normals, indicies, ParametricSpikes, 160, 160, true);
-	VAO sqiggle2VAO(positions, normals, indicies);
-
-	positions.clear();
-	normals.clear();
-	indicies.clear();
-	GenerateParametricShapeFrom2D(positions, normals, indicies, ParametricSpikes, 160, 160, true);
-	VAO flowerVAO(positions, normals, indicies);
-
-
 	/* Creating Programs */
-	GLuint wireframe = CreateProgramFromSources(
-		R"delimiter(
-#version 330 core
-	
-layout(location = 0) in vec3 a_position; //0 must be same as glVertexAttribPointer(0,
-layout(location = 1) in vec3 a_normal; 
-
-uniform mat4 u_transform;
-	
-out vec3 vertex_position;
-out vec3 vertex_normal;
+	Program wireframe = CreateProgramFromSources(
+		mesh_vertex_shader_source.c_str(),
 
-void main()
-{	
-	gl_Position = u_transform * vec4(a_position, 1);
-	vertex_normal = vec3(u_transform* vec4(a_normal,0));
-	vertex_position = vec3(gl_Position);
-}
-	
-)delimiter",
-
-R"delimiter(
+WithUniformBlocks(R"delimiter(
 #version 330 core
 
-uniform vec2 u_mouse_position;
-	
 in vec3 vertex_position;
 in vec3 vertex_normal;
 	
@@ -163,40 +258,20 @@ void main()
 	out_color = vec4(1, 1, 1, 1);
 }
 	
-)delimiter");
+)delimiter").c_str());
 
-	if (wireframe == NULL)
+	if (wireframe.id == 0 || !BindUniformBlocks(wireframe))
 	{
 		glfwTerminate();
 		return -1;
 	}
 
-	GLuint normal = CreateProgramFromSources(
-		R"delimiter(
-#version 330 core
-	
-layout(location = 0) in vec3 a_position; //0 must be same as glVertexAttribPointer(0,
-layout(location = 1) in vec3 a_normal; 
+	Program normal = CreateProgramFromSources(
+		mesh_vertex_shader_source.c_str(),
 
-uniform mat4 u_transform;
-	
-out vec3 vertex_position;
-out vec3 vertex_normal;
-
-void main()
-{	
-	gl_Position = u_transform * vec4(a_position, 1);
-	vertex_normal = vec3(u_transform* vec4(a_normal,0));
-	vertex_position = vec3(gl_Position);
-}
-	
-)delimiter",
-
-R"delimiter(
+WithUniformBlocks(R"delimiter(
 #version 330 core
 
-uniform vec2 u_mouse_position;
-	
 in vec3 vertex_position;
 in vec3 vertex_normal;
 	
@@ -223,40 +298,20 @@ void main()
 	out_color = vec4(color, 1);
 }
 	
-)delimiter");
+)delimiter").c_str());
 
-	if (normal == NULL)
+	if (normal.id == 0 || !BindUniformBlocks(normal))
 	{
 		glfwTerminate();
 		return -1;
 	}
 
-	GLuint grey = CreateProgramFromSources(
-		R"delimiter(
-#version 330 core
-	
-layout(location = 0) in vec3 a_position; 
-layout(location = 1) in vec3 a_normal; 
-
-uniform mat4 u_transform;
-	
-out vec3 vertex_position;
-out vec3 vertex_normal;
-
-void main()
-{	
-	gl_Position = u_transform * vec4(a_position, 1);
-	vertex_normal = vec3(u_transform* vec4(a_normal,0));
-	vertex_position = vec3(gl_Position);
-}
-	
-)delimiter",
+	Program grey = CreateProgramFromSources(
+		mesh_vertex_shader_source.c_str(),
 
-R"delimiter(
+WithUniformBlocks(R"delimiter(
 #version 330 core
 
-uniform vec2 u_mouse_position;
-	
 in vec3 vertex_position;
 in vec3 vertex_normal;
 	
@@ -290,40 +345,54 @@ void main()
 	out_color = vec4(color, 1);
 }
 	
-)delimiter");
+)delimiter").c_str());
 
-	if (grey == NULL)
+	if (grey.id == 0 || !BindUniformBlocks(grey))
 	{
 		glfwTerminate();
 		return -1;
 	}
 
-	GLuint color = CreateProgramFromSources(
-		R"VERTEX(
-#version 330 core
+	Program color = CreateProgramFromSources(mesh_vertex_shader_source.c_str(), color_fragment_shader_source.c_str());
 
-layout(location = 0) in vec3 a_position;
-layout(location = 1) in vec3 a_normal;
+	if (color.id == 0 || !BindUniformBlocks(color))
+	{
+		glfwTerminate();
+		return -1;
+	}
 
-uniform mat4 u_transform;
+	Program procedural_color = CreateProgramFromSources(ProceduralShapeVertexShader, color_fragment_shader_source.c_str());
 
-out vec3 vertex_position;
-out vec3 vertex_normal;
+	if (procedural_color.id == 0 || !BindUniformBlocks(procedural_color))
+	{
+		glfwTerminate();
+		return -1;
+	}
 
-void main()
-{
-	gl_Position = u_transform * vec4(a_position, 1);
-	vertex_normal = vec3(u_transform * vec4(a_normal, 0));
-	vertex_position = vec3(gl_Position);
-}
-		)VERTEX",
+	// id stays 0 on GL 3.3, where the I scene draws the meshes instead
+	Program tessellated_color;
+	if (TessellationSupported())
+	{
+		tessellated_color = CreateProgramFromSources(
+			TessellatedShapeVertexShader,
+			TessellatedShapeControlShader,
+			TessellatedShapeEvaluationShader,
+			color_fragment_shader_source.c_str()
+		);
+
+		if (tessellated_color.id == 0 || !BindUniformBlocks(tessellated_color))
+		{
+			glfwTerminate();
+			return -1;
+		}
+	}
 
-		R"FRAGMENT(
-#version 330 core
 
-uniform vec2 u_mouse_position;
-uniform vec3 u_color;
-uniform vec3 u_shininess;
+	Program creative = CreateProgramFromSources(
+		mesh_vertex_shader_source.c_str(),
+
+		WithUniformBlocks(R"FRAGMENT(
+#version 330 core
 
 in vec3 vertex_position;
 in vec3 vertex_normal;
@@ -338,104 +407,274 @@ void main()
 	vec3 surface_position = vertex_position;
 	vec3 surface_normal = normalize(vertex_normal);
 
-	vec3 ambient_color = vec3(0.5, 0.5 ,0.5);
-	color += ambient_color * surface_color;
+	vec3 ambient_color = vec3(255)/255.;
+	color += 0.0* ambient_color * surface_color;
 
-	vec3 light_direction = normalize(vec3(-1, -1, 1));
-	vec3 to_light = -normalize(light_direction);
-	vec3 light_color = vec3(0.4, 0.4, 0.4);
+	vec3 light_direction = normalize(vec3(1, 1, 1));
+	vec3 to_light = normalize(-1 * light_direction);
+	vec3 light_color = vec3(143, 3, 87)/255.;
 
 	float diffuse_intensity = max(0, dot(to_light, surface_normal));
 	color += diffuse_intensity * light_color * surface_color;
 
-	vec3 view_dir = normalize(vec3(0, 0, -1));	
-	vec3 halfway_dir = normalize(view_dir + to_light);
-	float specular_intensity = max(0, dot(halfway_dir, surface_normal));
-	float shiny = u_shininess.x;
-	color += pow(specular_intensity, shiny) * light_color;
-
-	vec3 light_direction2 = normalize(vec3(-u_mouse_position, 2));
-	vec3 to_light2 = -normalize(light_direction2);
-	vec3 light_color2 =  vec3(0.5);
+	vec3 light_direction2 = normalize(vec3(-1, 1, 1));
+	vec3 to_light2 = normalize(-1 * light_direction2);
+	vec3 light_color2 = vec3(0,0,1);
 
 	float diffuse_intensity2 = max(0, dot(to_light2, surface_normal));
 	color += diffuse_intensity2 * light_color2 * surface_color;
 
-	vec3 halfway_dir2 = normalize(view_dir + to_light2);
-	float specular_intensity2 = max(0, dot(halfway_dir2, surface_normal));
-	shiny = u_shininess.x;
-	color += pow(specular_intensity2, shiny) * light_color2;
-
 	out_color = vec4(color, 1);
 }
-		)FRAGMENT");
+		)FRAGMENT").c_str());
 
-	GLuint creative = CreateProgramFromSources(
-		R"VERTEX(
-#version 330 core
-
-layout(location = 0) in vec3 a_position;
-layout(location = 1) in vec3 a_normal;
-
-uniform mat4 u_transform;
-
-out vec3 vertex_position;
-out vec3 vertex_normal;
-
-void main()
-{
-	gl_Position = u_transform * vec4(a_position, 1);
-	vertex_normal = vec3(u_transform * vec4(a_normal, 0));
-	vertex_position = vec3(gl_Position);
-}
-		)VERTEX",
+	if (creative.id == 0 || !BindUniformBlocks(creative))
+	{
+		glfwTerminate();
+		return -1;
+	}
 
-		R"FRAGMENT(
-#version 330 core
+	/* Creating Meshes */
+	// After the programs, so no early return leaves meshes to be released
+	// once the context is gone
+	FloatParametricSampleGrid grid;
+	ParametricShapeOptions options;
+	options.thread_count = 0;
+
+	std::vector<glm::vec3> generated_positions;
+	std::vector<glm::vec3> generated_normals;
+	std::vector<GLuint> generated_indices;
+	std::vector<glm::vec3> optimized_positions;
+	std::vector<glm::vec3> optimized_normals;
+	std::vector<GLuint> optimized_indices;
+	MappedMeshFile cached_mesh;
+	MeshRegistry mesh_registry;
+
+	// Vertex cache behaviour of each mesh the optimization stage ran on this
+	// run, kept for --statistics
+	struct OptimizedMesh
+	{
+		std::string name;
+		VertexCacheStatistics before;
+		VertexCacheStatistics after;
+	};
+	std::vector<OptimizedMesh> optimized_meshes;
+
+	// Where the meshes came from, for the time to the first frame
+	size_t cached_mesh_count = 0;
+	size_t generated_mesh_count = 0;
+
+	// Every mesh shares the vertex array and buffers of the arena for its
+	// format, the strides differing between the two. Sized for the levels
+	// below; they grow if that runs out.
+	GeometryArena float_arena(VertexFormat::Float, GL_UNSIGNED_SHORT, 4096, 16384);
+	GeometryArena compressed_arena(VertexFormat::Compressed, GL_UNSIGNED_SHORT, 1 << 17, 1 << 20);
+
+	// Generates the mesh of key into the generated_ vectors and returns its
+	// bounding radius. Adaptive meshes are sampled to key.tolerance, the chord
+	// error of the uniform segment counts, with the rows and columns moved to
+	// where the shape bends. The naive column order already reuses the vertex cache when
+	// a whole column fits in it; longer columns go through the optimization
+	// stage.
+	auto GenerateParametricMesh = [&](glm::dvec2(*parametric_line)(double), const MeshCacheKey& key)
+	{
+		if (key.adaptive)
+		{
+			SampleAdaptiveParametricShapeFrom2D(grid, parametric_line, key.tolerance, key.squiggle);
+		}
+		else
+		{
+			SampleParametricShapeFrom2D(grid, parametric_line, key.vertical_segments, key.rotation_segments, key.squiggle);
+		}
 
-uniform vec2 u_mouse_position;
-uniform vec3 u_color;
-uniform vec3 u_shininess;
+		generated_positions.clear();
+		generated_normals.clear();
+		generated_indices.clear();
+		BuildParametricShapeOfRevolution(generated_positions, generated_normals, generated_indices, grid, options);
 
-in vec3 vertex_position;
-in vec3 vertex_normal;
+		if (grid.vertical_segments > int(MeshVertexCacheSize))
+		{
+			optimized_positions.resize(generated_positions.size());
+			optimized_normals.resize(generated_normals.size());
+			optimized_indices.resize(generated_indices.size());
 
-out vec4 out_color;
+			OptimizedMesh optimized;
+			if (print_statistics)
+			{
+				optimized.name = key.Name();
+				optimized.before = AnalyzeVertexCache(generated_indices.data(), generated_indices.size(), generated_positions.size());
+			}
 
-void main()
-{
-	vec3 color = vec3(0);
+			OptimizeVertexCache(generated_indices.data(), generated_indices.data(), generated_indices.size(), generated_positions.size());
+			OptimizeVertexFetch(
+				optimized_positions.data(), optimized_normals.data(), optimized_indices.data(),
+				generated_positions.data(), generated_normals.data(), generated_indices.data(),
+				generated_indices.size(), generated_positions.size()
+			);
 
-	vec3 surface_color = u_color;
-	vec3 surface_position = vertex_position;
-	vec3 surface_normal = normalize(vertex_normal);
+			generated_positions.swap(optimized_positions);
+			generated_normals.swap(optimized_normals);
+			generated_indices.swap(optimized_indices);
 
-	vec3 ambient_color = vec3(255)/255.;
-	color += 0.0* ambient_color * surface_color;
+			if (print_statistics)
+			{
+				optimized.after = AnalyzeVertexCache(generated_indices.data(), generated_indices.size(), generated_positions.size());
+				optimized_meshes.push_back(optimized);
+			}
+		}
 
-	vec3 light_direction = normalize(vec3(1, 1, 1));
-	vec3 to_light = normalize(-1 * light_direction);
-	vec3 light_color = vec3(143, 3, 87)/255.;
+		return BoundParametricShapeOfRevolution(grid);
+	};
 
-	float diffuse_intensity = max(0, dot(to_light, surface_normal));
-	color += diffuse_intensity * light_color * surface_color;
+	// Meshes already made this run come from the registry, and meshes
+	// generated by an earlier run are mapped from the mesh cache; anything
+	// else is generated and written to it.
+	auto CreateParametricVAO = [&](glm::dvec2(*parametric_line)(double), const MeshCacheKey& key, VertexFormat vertex_format, float& bounding_radius)
+	{
+		if (SharedVAO vao = mesh_registry.Find(key, vertex_format, bounding_radius))
+			return vao;
 
-	vec3 light_direction2 = normalize(vec3(-1, 1, 1));
-	vec3 to_light2 = normalize(-1 * light_direction2);
-	vec3 light_color2 = vec3(0,0,1);
+		const glm::vec3* positions;
+		const glm::vec3* normals;
+		const GLuint* indices;
+		size_t vertex_count, index_count;
 
-	float diffuse_intensity2 = max(0, dot(to_light2, surface_normal));
-	color += diffuse_intensity2 * light_color2 * surface_color;
+		if (cached_mesh.Open(key))
+		{
+			cached_mesh_count++;
+			positions = cached_mesh.positions;
+			normals = cached_mesh.normals;
+			indices = cached_mesh.indices;
+			vertex_count = cached_mesh.vertex_count;
+			index_count = cached_mesh.index_count;
+			bounding_radius = cached_mesh.bounding_radius;
+		}
+		else
+		{
+			generated_mesh_count++;
+			bounding_radius = GenerateParametricMesh(parametric_line, key);
+			WriteMeshCache(key, generated_positions, generated_normals, generated_indices, bounding_radius);
+
+			positions = generated_positions.data();
+			normals = generated_normals.data();
+			indices = generated_indices.data();
+			vertex_count = generated_positions.size();
+			index_count = generated_indices.size();
+		}
 
-	out_color = vec4(color, 1);
-}
-		)FRAGMENT");
+		GeometryArena& arena = vertex_format == VertexFormat::Compressed ? compressed_arena : float_arena;
+		SharedVAO vao = mesh_registry.Add(key, vertex_format, positions, normals, vertex_count, indices, index_count, bounding_radius, &arena);
+		cached_mesh.Close();
+		return vao;
+	};
 
-	if (creative == NULL)
+	// Halves the segment counts per level down to min_segments, below which
+	// the profile or the squiggle would alias
+	auto CreateParametricLOD = [&](glm::dvec2(*parametric_line)(double), int vertical_segments, int rotation_segments, int min_segments, bool squiggle, bool adaptive, VertexFormat vertex_format)
 	{
-		glfwTerminate();
-		return -1;
+		MeshCacheKey key;
+		if (auto name = FindParametricLineName(parametric_line))
+			key.profile = name;
+		key.squiggle = squiggle;
+		key.adaptive = adaptive;
+		key.topology = options.topology;
+		// grid is a FloatParametricSampleGrid
+		key.double_precision = false;
+
+		MeshLOD lod;
+		for (; glm::min(vertical_segments, rotation_segments) >= min_segments; vertical_segments /= 2, rotation_segments /= 2)
+		{
+			key.vertical_segments = vertical_segments;
+			key.rotation_segments = rotation_segments;
+			if (adaptive)
+				key.tolerance = MeasureParametricShapeOfRevolution(parametric_line, squiggle, vertical_segments, rotation_segments);
+
+			float bounding_radius;
+			SharedVAO vao = CreateParametricVAO(parametric_line, key, vertex_format, bounding_radius);
+			if (lod.levels.empty())
+				lod.bounding_radius = bounding_radius;
+
+			// Triangle lists, 3 indices per triangle
+			lod.AddLevel(vao, glm::min(vertical_segments, rotation_segments), vao->element_array_count / 3);
+		}
+		return lod;
+	};
+
+	// The dense meshes use the 12 byte compressed vertices. The squiggle and
+	// the spikes need about 4 segments per wave, so they stop at 40.
+	//
+	// sqiggle, sqiggle2 and the flowers have the squiggle baked in, with
+	// adaptive columns where its waves bend; sqiggle2 and the flowers are the
+	// same mesh. The O scene moves the waves, which columns placed for still
+	// ones can't follow, so it draws meshes uploaded without the squiggle,
+	// with uniform columns, that the vertex shader displaces. Those are about
+	// 50k triangles at the finest level against 13k-22k baked, so they are
+	// only made the first time the O scene is drawn.
+	ParametricSquiggle squiggle;
+	ParametricSquiggle no_squiggle;
+	no_squiggle.amplitude = 0;
+	no_squiggle.scale = 1;
+
+	MeshLOD sphereLOD = CreateParametricLOD(ParametricHalfCircle, 16, 16, 8, false, false, VertexFormat::Float);
+	MeshLOD torusLOD = CreateParametricLOD(ParametricCircle, 16, 16, 8, false, false, VertexFormat::Float);
+	MeshLOD sqiggleLOD = CreateParametricLOD(ParametricHalfSquiggle, 160, 160, 40, true, true, VertexFormat::Compressed);
+	MeshLOD sqiggle2LOD = CreateParametricLOD(ParametricSpikes, 160, 160, 40, true, true, VertexFormat::Compressed);
+	MeshLOD flowerLOD = CreateParametricLOD(ParametricSpikes, 160, 160, 40, true, true, VertexFormat::Compressed);
+
+	// Bounded at the widest scale of the squiggle
+	MeshLOD wave_sqiggleLOD, wave_sqiggle2LOD;
+	auto CreateWaveLODs = [&]()
+	{
+		wave_sqiggleLOD = CreateParametricLOD(ParametricHalfSquiggle, 160, 160, 40, false, false, VertexFormat::Compressed);
+		wave_sqiggle2LOD = CreateParametricLOD(ParametricSpikes, 160, 160, 40, false, false, VertexFormat::Compressed);
+		wave_sqiggleLOD.bounding_radius *= float(squiggle.scale * (1 + squiggle.amplitude));
+		wave_sqiggle2LOD.bounding_radius *= float(squiggle.scale * (1 + squiggle.amplitude));
+	};
+
+	// The squiggle a draw displaces by, as DrawUniforms::squiggle
+	auto SquiggleUniform = [](const ParametricSquiggle& squiggle)
+	{
+		return glm::vec4(float(squiggle.frequency), float(squiggle.amplitude), float(squiggle.phase), float(squiggle.scale));
+	};
+
+	// The shapes of the R scene evaluated in the vertex shader, at the
+	// resolution of the finest levels above
+	ProceduralShape sphere_shape, torus_shape, sqiggle_shape, sqiggle2_shape;
+	CreateProceduralShape(sphere_shape, ParametricHalfCircle, 16, 16);
+	CreateProceduralShape(torus_shape, ParametricCircle, 16, 16);
+	CreateProceduralShape(sqiggle_shape, ParametricHalfSquiggle, 160, 160);
+	CreateProceduralShape(sqiggle2_shape, ParametricSpikes, 160, 160);
+
+	// The coarse patch grids the GPU refines, a wave or less per patch edge
+	ProceduralShape sphere_patches, torus_patches, sqiggle_patches, sqiggle2_patches;
+	CreateProceduralShape(sphere_patches, ParametricHalfCircle, 5, 8);
+	CreateProceduralShape(torus_patches, ParametricCircle, 9, 8);
+	CreateProceduralShape(sqiggle_patches, ParametricHalfSquiggle, 9, 16);
+	CreateProceduralShape(sqiggle2_patches, ParametricSpikes, 17, 16);
+
+	if (print_statistics)
+	{
+		const auto& mesh_statistics = mesh_registry.Statistics();
+		std::cout << "Meshes: " << mesh_statistics.uploads << " uploaded for " << mesh_statistics.requests << " requests, "
+			<< mesh_statistics.bytes_saved / 1024 << " KiB shared, " << mesh_statistics.hash_collisions << " hash collisions" << std::endl;
+		for (const GeometryArena* arena : { &float_arena, &compressed_arena })
+		{
+			auto arena_statistics = arena->Statistics();
+			std::cout << "Arena: " << arena_statistics.allocations << " meshes in "
+				<< arena_statistics.used_vertices << "/" << arena_statistics.vertex_capacity << " vertices, "
+				<< arena_statistics.used_indices << "/" << arena_statistics.index_capacity << " indices, "
+				<< arena_statistics.grows << " grows" << std::endl;
+		}
+		for (const auto& optimized : optimized_meshes)
+		{
+			std::cout << "Optimized " << optimized.name << ": ACMR " << optimized.before.acmr << " -> " << optimized.after.acmr
+				<< ", ATVR " << optimized.before.atvr << " -> " << optimized.after.atvr << std::endl;
+		}
 	}
+
+	// Per-frame data the scenes write for their draws
+	StreamBuffer frame_stream(256 * 1024);
+
 	Globals.key = GLFW_KEY_Q;
 	glm::dvec2 chasing_pos = glm::dvec2(0);
 	glm::dvec2 chasing_pos_list[36];
@@ -443,38 +682,137 @@ void main()
 	{
 		chasing_pos_list[i] = glm::dvec2(0);//glm::ballRand(0.5);
 	}
+
+	// Level of detail each draw used last frame, see SelectMeshLOD
+	int sphere_level = -1, torus_level = -1, sqiggle_level = -1, sqiggle2_level = -1, chaser_level = -1;
+	int wave_sqiggle_level = -1, wave_sqiggle2_level = -1;
+	int flower_levels[36];
+	for (int i = 0; i < 36; i++)
+	{
+		flower_levels[i] = -1;
+	}
+	// Triangles the Y scene's chosen levels drew, summed over its frames
+	uint64_t flower_triangles = 0, flower_frames = 0;
+	GLsizei flower_triangles_min = 0, flower_triangles_max = 0;
+	const uint64_t flower_finest_triangles = 36 * uint64_t(flowerLOD.triangle_counts[0]);
+	// A scene queues its draws with their uniforms, then draws them all once
+	// the uniforms are written: the per-draw uniforms of a frame go to the GPU
+	// together in one bound array, and each draw only sets its index into it.
+	struct SceneDraw
+	{
+		GLsizei uniforms;
+		const VAO* vao;
+		const ProceduralShape* shape;
+		bool tessellated;
+	};
+	std::vector<SceneDraw> scene_draws;
+	DrawUniformsArray draw_uniforms;
+
+	// Picks the level of lod for the draw's transform and dequantizes with it,
+	// returning the level's triangle count as DrawMeshLOD does
+	auto QueueMeshLOD = [&](const MeshLOD& lod, DrawUniforms uniforms, int& level) -> GLsizei
+	{
+		level = SelectMeshLOD(lod, ProjectMeshLODRadius(lod, uniforms.transform, Globals.screen_dimensions), level);
+		const VAO& vao = *lod.levels[level];
+		uniforms.position_scale = vao.position_scale;
+		uniforms.position_offset = vao.position_offset;
+		scene_draws.push_back({ AddDrawUniforms(draw_uniforms, uniforms), &vao, nullptr, false });
+		return lod.triangle_counts[level];
+	};
+
+	auto QueueShape = [&](const ProceduralShape& shape, const DrawUniforms& uniforms, bool tessellated)
+	{
+		scene_draws.push_back({ AddDrawUniforms(draw_uniforms, uniforms), nullptr, &shape, tessellated });
+	};
+
+	// Draws the queued draws with program, which must be in use. Draws past
+	// DrawUniformsCapacity have no uniforms and are dropped.
+	//
+	// Meshes in the same arena share its vertex array, so a run of them binds
+	// it once. The programs read the dequantization from each draw's element,
+	// which QueueMeshLOD fills, so nothing else of BindVAO is needed per draw.
+	auto DrawScene = [&](const Program& program)
+	{
+		frame_stream.Flush();
+		BindDrawUniforms(draw_uniforms);
+		GLuint bound_vertex_array = 0;
+		for (const auto& draw : scene_draws)
+		{
+			if (draw.uniforms < 0)
+				continue;
+
+			SelectDrawUniforms(program, draw.uniforms);
+			if (draw.vao)
+			{
+				if (draw.vao->id != bound_vertex_array)
+				{
+					BindVAO(*draw.vao, program);
+					bound_vertex_array = draw.vao->id;
+				}
+				DrawVAO(*draw.vao);
+			}
+			else if (draw.tessellated)
+			{
+				DrawTessellatedShape(*draw.shape, program, Globals.screen_dimensions);
+				bound_vertex_array = draw.shape->vertex_array;
+			}
+			else
+			{
+				DrawProceduralShape(*draw.shape, program);
+				bound_vertex_array = draw.shape->vertex_array;
+			}
+		}
+		scene_draws.clear();
+	};
+
 	/* Loop until the user closes the window */
 	while (!glfwWindowShouldClose(window))
 	{
 		/* Render here */
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		frame_stream.BeginFrame();
+
+		glm::dvec2 frame_mouse = Globals.mouse_position / glm::dvec2(Globals.screen_dimensions);
+		frame_mouse.y = 1. - frame_mouse.y;
+		frame_mouse = frame_mouse * 2. - 1.;
+
+		FrameUniforms frame;
+		frame.mouse_position = glm::vec2(frame_mouse);
+		frame.light_direction = glm::vec3(-1, -1, 1);
+		frame.light_color = glm::vec3(0.4);
+		frame.ambient_color = glm::vec3(0.5);
+		BindFrameUniforms(frame_stream, frame);
+		CreateDrawUniformsArray(draw_uniforms, frame_stream);
+
+		// The O scene is the R scene with the waves travelling around the
+		// squiggled shapes. Everywhere else they stand still, as they are in
+		// the baked meshes.
+		squiggle.phase = Globals.key == GLFW_KEY_O ? glfwGetTime() * glm::radians(90.) : 0.;
 
 		if (Globals.key == GLFW_KEY_Q)
 		{
 			glClearColor(0,0,0,1);
-			glUseProgram(wireframe);
+			glUseProgram(wireframe.id);
+			DrawUniforms uniforms;
+			uniforms.squiggle = SquiggleUniform(no_squiggle);
 
-			auto u_transform_location = glGetUniformLocation(wireframe, "u_transform");
-			
 			glm::mat4 transform(1.0);
 			transform = glm::scale(transform, glm::vec3(0.46));
 			transform = glm::translate(transform, glm::vec3(-1.1, 1, 0));
 			transform = glm::rotate(transform, float(glfwGetTime() * glm::radians(10.)), glm::vec3(1, 1, 0));
-			glUniformMatrix4fv(u_transform_location, 1, GL_FALSE, glm::value_ptr(transform));
+			uniforms.transform = transform;
 
-			glBindVertexArray(sphereVAO.id);
 			glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-			glDrawElements(GL_TRIANGLES, sphereVAO.element_array_count, GL_UNSIGNED_INT, NULL);
+			QueueMeshLOD(sphereLOD, uniforms, sphere_level);
 
 			glm::mat4 transform2(1.0);
 			transform2 = glm::scale(transform2, glm::vec3(0.46));
 			transform2 = glm::translate(transform2, glm::vec3(1, 1, 0));
 			transform2 = glm::rotate(transform2, glm::radians(float(glfwGetTime() * 10)), glm::vec3(1, 1, 0));
 
-			glUniformMatrix4fv(u_transform_location, 1, GL_FALSE, glm::value_ptr(transform2));
+			uniforms.transform = transform2;
 
-			glBindVertexArray(torusVAO.id);
-			glDrawElements(GL_TRIANGLES, torusVAO.element_array_count, GL_UNSIGNED_INT, NULL);
+			QueueMeshLOD(torusLOD, uniforms, torus_level);
 
 
 			glm::mat4 transform3(1.0);
@@ -482,46 +820,45 @@ void main()
 			transform3 = glm::translate(transform3, glm::vec3(1.5, -1.5, 0));
 			transform3 = glm::rotate(transform3, glm::radians(float(glfwGetTime() * 10)), glm::vec3(1, 1, 0));
 
-			glUniformMatrix4fv(u_transform_location, 1, GL_FALSE, glm::value_ptr(transform3));
+			uniforms.transform = transform3;
 
-			glBindVertexArray(sqiggleVAO.id);
-			glDrawElements(GL_TRIANGLES, sqiggleVAO.element_array_count, GL_UNSIGNED_INT, NULL);
+			QueueMeshLOD(sqiggleLOD, uniforms, sqiggle_level);
 
 			glm::mat4 transform4(1.0);
 			transform4 = glm::scale(transform4, glm::vec3(0.4));
 			transform4 = glm::translate(transform4, glm::vec3(-1.2, -1.2, 0));
 			transform4 = glm::rotate(transform4, glm::radians(float(glfwGetTime() * 10)), glm::vec3(1, 1, 0));
 
-			glUniformMatrix4fv(u_transform_location, 1, GL_FALSE, glm::value_ptr(transform4));
+			uniforms.transform = transform4;
+
+			QueueMeshLOD(sqiggle2LOD, uniforms, sqiggle2_level);
 
-			glBindVertexArray(sqiggle2VAO.id);
-			glDrawElements(GL_TRIANGLES, sqiggle2VAO.element_array_count, GL_UNSIGNED_INT, NULL);
+			DrawScene(wireframe);
 		}
 		else if (Globals.key == GLFW_KEY_W)
 		{
 			glClearColor(0, 0, 0, 1);
-			glUseProgram(normal);
+			glUseProgram(normal.id);
+			DrawUniforms uniforms;
+			uniforms.squiggle = SquiggleUniform(no_squiggle);
 			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-			auto u_transform_location = glGetUniformLocation(wireframe, "u_transform");
 
 			glm::mat4 transform(1.0);
 			transform = glm::scale(transform, glm::vec3(0.46));
 			transform = glm::translate(transform, glm::vec3(-1.1, 1, 0));
 			transform = glm::rotate(transform, float(glfwGetTime() * glm::radians(10.)), glm::vec3(1, 1, 0));
-			glUniformMatrix4fv(u_transform_location, 1, GL_FALSE, glm::value_ptr(transform));
+			uniforms.transform = transform;
 
-			glBindVertexArray(sphereVAO.id);
-			glDrawElements(GL_TRIANGLES, sphereVAO.element_array_count, GL_UNSIGNED_INT, NULL);
+			QueueMeshLOD(sphereLOD, uniforms, sphere_level);
 
 			glm::mat4 transform2(1.0);
 			transform2 = glm::scale(transform2, glm::vec3(0.46));
 			transform2 = glm::translate(transform2, glm::vec3(1, 1, 0));
 			transform2 = glm::rotate(transform2, glm::radians(float(glfwGetTime() * 10)), glm::vec3(1, 1, 0));
 
-			glUniformMatrix4fv(u_transform_location, 1, GL_FALSE, glm::value_ptr(transform2));
+			uniforms.transform = transform2;
 
-			glBindVertexArray(torusVAO.id);
-			glDrawElements(GL_TRIANGLES, torusVAO.element_array_count, GL_UNSIGNED_INT, NULL);
+			QueueMeshLOD(torusLOD, uniforms, torus_level);
 
 
 			glm::mat4 transform3(1.0);
@@ -529,46 +866,45 @@ void main()
 			transform3 = glm::translate(transform3, glm::vec3(1.5, -1.5, 0));
 			transform3 = glm::rotate(transform3, glm::radians(float(glfwGetTime() * 10)), glm::vec3(1, 1, 0));
 
-			glUniformMatrix4fv(u_transform_location, 1, GL_FALSE, glm::value_ptr(transform3));
+			uniforms.transform = transform3;
 
-			glBindVertexArray(sqiggleVAO.id);
-			glDrawElements(GL_TRIANGLES, sqiggleVAO.element_array_count, GL_UNSIGNED_INT, NULL);
+			QueueMeshLOD(sqiggleLOD, uniforms, sqiggle_level);
 
 			glm::mat4 transform4(1.0);
 			transform4 = glm::scale(transform4, glm::vec3(0.4));
 			transform4 = glm::translate(transform4, glm::vec3(-1.2, -1.2, 0));
 			transform4 = glm::rotate(transform4, glm::radians(float(glfwGetTime() * 10)), glm::vec3(1, 1, 0));
 
-			glUniformMatrix4fv(u_transform_location, 1, GL_FALSE, glm::value_ptr(transform4));
+			uniforms.transform = transform4;
 
-			glBindVertexArray(sqiggle2VAO.id);
-			glDrawElements(GL_TRIANGLES, sqiggle2VAO.element_array_count, GL_UNSIGNED_INT, NULL);
+			QueueMeshLOD(sqiggle2LOD, uniforms, sqiggle2_level);
+
+			DrawScene(normal);
 		}
 		else if (Globals.key == GLFW_KEY_E)
 		{
 			glClearColor(0, 0, 0, 1);
-			glUseProgram(grey);
+			glUseProgram(grey.id);
+			DrawUniforms uniforms;
+			uniforms.squiggle = SquiggleUniform(no_squiggle);
 			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-			auto u_transform_location = glGetUniformLocation(wireframe, "u_transform");
 
 			glm::mat4 transform(1.0);
 			transform = glm::scale(transform, glm::vec3(0.46));
 			transform = glm::translate(transform, glm::vec3(-1.1, 1, 0));
 			transform = glm::rotate(transform, float(glfwGetTime() * glm::radians(10.)), glm::vec3(1, 1, 0));
-			glUniformMatrix4fv(u_transform_location, 1, GL_FALSE, glm::value_ptr(transform));
+			uniforms.transform = transform;
 
-			glBindVertexArray(sphereVAO.id);
-			glDrawElements(GL_TRIANGLES, sphereVAO.element_array_count, GL_UNSIGNED_INT, NULL);
+			QueueMeshLOD(sphereLOD, uniforms, sphere_level);
 
 			glm::mat4 transform2(1.0);
 			transform2 = glm::scale(transform2, glm::vec3(0.46));
 			transform2 = glm::translate(transform2, glm::vec3(1, 1, 0));
 			transform2 = glm::rotate(transform2, glm::radians(float(glfwGetTime() * 10)), glm::vec3(1, 1, 0));
 
-			glUniformMatrix4fv(u_transform_location, 1, GL_FALSE, glm::value_ptr(transform2));
+			uniforms.transform = transform2;
 
-			glBindVertexArray(torusVAO.id);
-			glDrawElements(GL_TRIANGLES, torusVAO.element_array_count, GL_UNSIGNED_INT, NULL);
+			QueueMeshLOD(torusLOD, uniforms, torus_level);
 
 
 			glm::mat4 transform3(1.0);
@@ -576,97 +912,222 @@ void main()
 			transform3 = glm::translate(transform3, glm::vec3(1.5, -1.5, 0));
 			transform3 = glm::rotate(transform3, glm::radians(float(glfwGetTime() * 10)), glm::vec3(1, 1, 0));
 
-			glUniformMatrix4fv(u_transform_location, 1, GL_FALSE, glm::value_ptr(transform3));
+			uniforms.transform = transform3;
 
-			glBindVertexArray(sqiggleVAO.id);
-			glDrawElements(GL_TRIANGLES, sqiggleVAO.element_array_count, GL_UNSIGNED_INT, NULL);
+			QueueMeshLOD(sqiggleLOD, uniforms, sqiggle_level);
 
 			glm::mat4 transform4(1.0);
 			transform4 = glm::scale(transform4, glm::vec3(0.4));
 			transform4 = glm::translate(transform4, glm::vec3(-1.2, -1.2, 0));
 			transform4 = glm::rotate(transform4, glm::radians(float(glfwGetTime() * 10)), glm::vec3(1, 1, 0));
 
-			glUniformMatrix4fv(u_transform_location, 1, GL_FALSE, glm::value_ptr(transform4));
+			uniforms.transform = transform4;
+
+			QueueMeshLOD(sqiggle2LOD, uniforms, sqiggle2_level);
 
-			glBindVertexArray(sqiggle2VAO.id);
-			glDrawElements(GL_TRIANGLES, sqiggle2VAO.element_array_count, GL_UNSIGNED_INT, NULL);
+			DrawScene(grey);
 		}
-		else if (Globals.key == GLFW_KEY_R)
+		else if (Globals.key == GLFW_KEY_R || Globals.key == GLFW_KEY_O)
 		{
+			// O draws the meshes the vertex shader moves the waves on
+			bool waves = Globals.key == GLFW_KEY_O;
+			if (waves && wave_sqiggleLOD.levels.empty())
+				CreateWaveLODs();
+
 			glClearColor(0, 0, 0, 1);
-			glUseProgram(color);
+			glUseProgram(color.id);
+			DrawUniforms uniforms;
+			uniforms.squiggle = SquiggleUniform(no_squiggle);
 			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-			auto u_transform_location = glGetUniformLocation(color, "u_transform");
-			auto mouse_location = glGetUniformLocation(color, "u_mouse_position");
-			auto color_location = glGetUniformLocation(color, "u_color");
-			auto shininess_location = glGetUniformLocation(color, "u_shininess");
 
-			auto normalized_mouse = Globals.mouse_position / glm::dvec2(Globals.screen_dimensions);
-			normalized_mouse.y = 1. - normalized_mouse.y;
-			normalized_mouse = normalized_mouse * 2. - 1.;
+			glm::mat4 transform(1.0);
+			transform = glm::scale(transform, glm::vec3(0.46));
+			transform = glm::translate(transform, glm::vec3(-1.1, 1, 0));
+			transform = glm::rotate(transform, float(glfwGetTime() * glm::radians(10.)), glm::vec3(1, 1, 0));
+			uniforms.transform = transform;
+			uniforms.color = glm::vec3(0.5, 0.5, 0.5);
+			uniforms.shininess = 128;
+
+			QueueMeshLOD(sphereLOD, uniforms, sphere_level);
+
+			glm::mat4 transform2(1.0);
+			transform2 = glm::scale(transform2, glm::vec3(0.46));
+			transform2 = glm::translate(transform2, glm::vec3(1, 1, 0));
+			transform2 = glm::rotate(transform2, glm::radians(float(glfwGetTime() * 10)), glm::vec3(1, 1, 0));
+			uniforms.transform = transform2;
+			uniforms.color = glm::vec3(1, 0, 0);
+			uniforms.shininess = 32;
+
+			QueueMeshLOD(torusLOD, uniforms, torus_level);
+
+
+			glm::mat4 transform3(1.0);
+			transform3 = glm::scale(transform3, glm::vec3(0.3));
+			transform3 = glm::translate(transform3, glm::vec3(1.5, -1.5, 0));
+			transform3 = glm::rotate(transform3, glm::radians(float(glfwGetTime() * 10)), glm::vec3(1, 1, 0));
+
+			uniforms.transform = transform3;
+			uniforms.color = glm::vec3(0, 0, 1);
+			uniforms.shininess = 64;
+
+			if (waves)
+			{
+				uniforms.squiggle = SquiggleUniform(squiggle);
+				QueueMeshLOD(wave_sqiggleLOD, uniforms, wave_sqiggle_level);
+			}
+			else
+			{
+				QueueMeshLOD(sqiggleLOD, uniforms, sqiggle_level);
+			}
+
+			glm::mat4 transform4(1.0);
+			transform4 = glm::scale(transform4, glm::vec3(0.4));
+			transform4 = glm::translate(transform4, glm::vec3(-1.2, -1.2, 0));
+			transform4 = glm::rotate(transform4, glm::radians(float(glfwGetTime() * 10)), glm::vec3(1, 1, 0));
+
+			uniforms.transform = transform4;
+			uniforms.color = glm::vec3(0, 1, 0);
+			uniforms.shininess = 300;
+
+			if (waves)
+				QueueMeshLOD(wave_sqiggle2LOD, uniforms, wave_sqiggle2_level);
+			else
+				QueueMeshLOD(sqiggle2LOD, uniforms, sqiggle2_level);
+
+			DrawScene(color);
+		}
+		else if (Globals.key == GLFW_KEY_U)
+		{
+			// The R scene with no vertex buffers
+			glClearColor(0, 0, 0, 1);
+			glUseProgram(procedural_color.id);
+			DrawUniforms uniforms;
+			uniforms.squiggle = SquiggleUniform(no_squiggle);
+			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+			glm::mat4 transform(1.0);
+			transform = glm::scale(transform, glm::vec3(0.46));
+			transform = glm::translate(transform, glm::vec3(-1.1, 1, 0));
+			transform = glm::rotate(transform, float(glfwGetTime() * glm::radians(10.)), glm::vec3(1, 1, 0));
+			uniforms.transform = transform;
+			uniforms.color = glm::vec3(0.5, 0.5, 0.5);
+			uniforms.shininess = 128;
+
+			QueueShape(sphere_shape, uniforms, false);
+
+			glm::mat4 transform2(1.0);
+			transform2 = glm::scale(transform2, glm::vec3(0.46));
+			transform2 = glm::translate(transform2, glm::vec3(1, 1, 0));
+			transform2 = glm::rotate(transform2, glm::radians(float(glfwGetTime() * 10)), glm::vec3(1, 1, 0));
+			uniforms.transform = transform2;
+			uniforms.color = glm::vec3(1, 0, 0);
+			uniforms.shininess = 32;
+
+			QueueShape(torus_shape, uniforms, false);
+
+
+			glm::mat4 transform3(1.0);
+			transform3 = glm::scale(transform3, glm::vec3(0.3));
+			transform3 = glm::translate(transform3, glm::vec3(1.5, -1.5, 0));
+			transform3 = glm::rotate(transform3, glm::radians(float(glfwGetTime() * 10)), glm::vec3(1, 1, 0));
+
+			uniforms.transform = transform3;
+			uniforms.color = glm::vec3(0, 0, 1);
+			uniforms.shininess = 64;
+
+			uniforms.squiggle = SquiggleUniform(squiggle);
+			QueueShape(sqiggle_shape, uniforms, false);
+
+			glm::mat4 transform4(1.0);
+			transform4 = glm::scale(transform4, glm::vec3(0.4));
+			transform4 = glm::translate(transform4, glm::vec3(-1.2, -1.2, 0));
+			transform4 = glm::rotate(transform4, glm::radians(float(glfwGetTime() * 10)), glm::vec3(1, 1, 0));
 
-			glUniform2fv(mouse_location, 1, glm::value_ptr(glm::vec2(normalized_mouse)));
+			uniforms.transform = transform4;
+			uniforms.color = glm::vec3(0, 1, 0);
+			uniforms.shininess = 300;
+
+			QueueShape(sqiggle2_shape, uniforms, false);
+
+			DrawScene(procedural_color);
+		}
+		else if (Globals.key == GLFW_KEY_I)
+		{
+			// The R scene refined on the GPU, or as it is on GL 3.3
+			const Program& program = tessellated_color.id ? tessellated_color : color;
+			auto QueueSurface = [&](const ProceduralShape& shape, const MeshLOD& lod, DrawUniforms uniforms, int& level)
+			{
+				if (tessellated_color.id)
+				{
+					QueueShape(shape, uniforms, true);
+				}
+				else
+				{
+					// The meshes have the squiggle baked in
+					uniforms.squiggle = SquiggleUniform(no_squiggle);
+					QueueMeshLOD(lod, uniforms, level);
+				}
+			};
+
+			glClearColor(0, 0, 0, 1);
+			glUseProgram(program.id);
+			DrawUniforms uniforms;
+			uniforms.squiggle = SquiggleUniform(no_squiggle);
+			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
 			glm::mat4 transform(1.0);
 			transform = glm::scale(transform, glm::vec3(0.46));
 			transform = glm::translate(transform, glm::vec3(-1.1, 1, 0));
 			transform = glm::rotate(transform, float(glfwGetTime() * glm::radians(10.)), glm::vec3(1, 1, 0));
-			glUniformMatrix4fv(u_transform_location, 1, GL_FALSE, glm::value_ptr(transform));
-			glUniform3fv(color_location, 1, glm::value_ptr(glm::vec3(0.5, 0.5, 0.5)));
-			glUniform3fv(shininess_location, 1, glm::value_ptr(glm::vec3(128, 0, 0)));
+			uniforms.transform = transform;
+			uniforms.color = glm::vec3(0.5, 0.5, 0.5);
+			uniforms.shininess = 128;
 
-			glBindVertexArray(sphereVAO.id);
-			glDrawElements(GL_TRIANGLES, sphereVAO.element_array_count, GL_UNSIGNED_INT, NULL);
+			QueueSurface(sphere_patches, sphereLOD, uniforms, sphere_level);
 
 			glm::mat4 transform2(1.0);
 			transform2 = glm::scale(transform2, glm::vec3(0.46));
 			transform2 = glm::translate(transform2, glm::vec3(1, 1, 0));
 			transform2 = glm::rotate(transform2, glm::radians(float(glfwGetTime() * 10)), glm::vec3(1, 1, 0));
-			glUniform2fv(mouse_location, 1, glm::value_ptr(glm::vec2(normalized_mouse)));
-			glUniformMatrix4fv(u_transform_location, 1, GL_FALSE, glm::value_ptr(transform2));
-			glUniform3fv(color_location, 1, glm::value_ptr(glm::vec3(1, 0, 0)));
-			glUniform3fv(shininess_location, 1, glm::value_ptr(glm::vec3(32, 0, 0)));
+			uniforms.transform = transform2;
+			uniforms.color = glm::vec3(1, 0, 0);
+			uniforms.shininess = 32;
 
-			glBindVertexArray(torusVAO.id);
-			glDrawElements(GL_TRIANGLES, torusVAO.element_array_count, GL_UNSIGNED_INT, NULL);
+			QueueSurface(torus_patches, torusLOD, uniforms, torus_level);
 
 
 			glm::mat4 transform3(1.0);
 			transform3 = glm::scale(transform3, glm::vec3(0.3));
 			transform3 = glm::translate(transform3, glm::vec3(1.5, -1.5, 0));
 			transform3 = glm::rotate(transform3, glm::radians(float(glfwGetTime() * 10)), glm::vec3(1, 1, 0));
-			glUniform2fv(mouse_location, 1, glm::value_ptr(glm::vec2(normalized_mouse)));
 
-			glUniformMatrix4fv(u_transform_location, 1, GL_FALSE, glm::value_ptr(transform3));
-			glUniform3fv(color_location, 1, glm::value_ptr(glm::vec3(0, 0, 1)));
-			glUniform3fv(shininess_location, 1, glm::value_ptr(glm::vec3(64, 0, 0)));
+			uniforms.transform = transform3;
+			uniforms.color = glm::vec3(0, 0, 1);
+			uniforms.shininess = 64;
 
-			glBindVertexArray(sqiggleVAO.id);
-			glDrawElements(GL_TRIANGLES, sqiggleVAO.element_array_count, GL_UNSIGNED_INT, NULL);
+			uniforms.squiggle = SquiggleUniform(squiggle);
+			QueueSurface(sqiggle_patches, sqiggleLOD, uniforms, sqiggle_level);
 
 			glm::mat4 transform4(1.0);
 			transform4 = glm::scale(transform4, glm::vec3(0.4));
 			transform4 = glm::translate(transform4, glm::vec3(-1.2, -1.2, 0));
 			transform4 = glm::rotate(transform4, glm::radians(float(glfwGetTime() * 10)), glm::vec3(1, 1, 0));
-			glUniform2fv(mouse_location, 1, glm::value_ptr(glm::vec2(normalized_mouse)));
 
-			glUniformMatrix4fv(u_transform_location, 1, GL_FALSE, glm::value_ptr(transform4));
-			glUniform3fv(color_location, 1, glm::value_ptr(glm::vec3(0, 1, 0)));
-			glUniform3fv(shininess_location, 1, glm::value_ptr(glm::vec3(300, 0, 0)));
+			uniforms.transform = transform4;
+			uniforms.color = glm::vec3(0, 1, 0);
+			uniforms.shininess = 300;
 
-			glBindVertexArray(sqiggle2VAO.id);
-			glDrawElements(GL_TRIANGLES, sqiggle2VAO.element_array_count, GL_UNSIGNED_INT, NULL);
+			QueueSurface(sqiggle2_patches, sqiggle2LOD, uniforms, sqiggle2_level);
 
+			DrawScene(program);
 		}
 		else if (Globals.key == GLFW_KEY_T)
 		{
 			glClearColor(0, 0, 0, 1);
-			glUseProgram(color);
+			glUseProgram(color.id);
+			DrawUniforms uniforms;
+			uniforms.squiggle = SquiggleUniform(no_squiggle);
 			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-			auto mouse_location = glGetUniformLocation(color, "u_mouse_position");
-			auto color_location = glGetUniformLocation(color, "u_color");
-			auto u_transform_location = glGetUniformLocation(color, "u_transform");
-			auto shininess_location = glGetUniformLocation(color, "u_shininess");
 
 			glm::dvec2 normalized_mouse = Globals.mouse_position / glm::dvec2(Globals.screen_dimensions);
 			normalized_mouse.y = 1. - normalized_mouse.y;
@@ -677,40 +1138,37 @@ void main()
 			chasing_pos = glm::mix(normalized_mouse, chasing_pos, 0.99);
 			transform2 = glm::translate(transform2, glm::vec3(chasing_pos, 1));
 			transform2 = glm::scale(transform2, glm::vec3(0.3));
-			glUniformMatrix4fv(u_transform_location, 1, GL_FALSE, glm::value_ptr(transform2));
-			glUniform2fv(mouse_location, 1, glm::value_ptr(glm::vec2(normalized_mouse)));
-			glUniform3fv(color_location, 1, glm::value_ptr(glm::vec3(0.5, 0.5, 0.5)));
-			glUniform3fv(shininess_location, 1, glm::value_ptr(glm::vec3(100, 0, 0)));
-			glBindVertexArray(sphereVAO.id);
-			glDrawElements(GL_TRIANGLES, sphereVAO.element_array_count, GL_UNSIGNED_INT, NULL);
+			uniforms.transform = transform2;
+			uniforms.color = glm::vec3(0.5, 0.5, 0.5);
+			uniforms.shininess = 100;
+			QueueMeshLOD(sphereLOD, uniforms, chaser_level);
 
 			glm::mat4 transform(1.0);
 			transform = glm::translate(transform, glm::vec3(normalized_mouse, 1));
 			transform = glm::scale(transform, glm::vec3(0.3));			
-			glUniformMatrix4fv(u_transform_location, 1, GL_FALSE, glm::value_ptr(transform));
-			glUniform2fv(mouse_location, 1, glm::value_ptr(glm::vec2(normalized_mouse)));
-			glUniform3fv(shininess_location, 1, glm::value_ptr(glm::vec3(100, 0, 0)));
+			uniforms.transform = transform;
+			uniforms.shininess = 100;
 			GLfloat distance = glm::pow((glm::pow((chasing_pos.x - normalized_mouse.x),2) + glm::pow((chasing_pos.y - normalized_mouse.y),2)),0.5);
 			if (distance > 0.3*2)
 			{
-				glUniform3fv(color_location, 1, glm::value_ptr(glm::vec3(0,1,0)));
+				uniforms.color = glm::vec3(0,1,0);
 			}
 			else
 			{
-				glUniform3fv(color_location, 1, glm::value_ptr(glm::vec3(1, 0, 0)));
+				uniforms.color = glm::vec3(1, 0, 0);
 			}
 	
-			glDrawElements(GL_TRIANGLES, sphereVAO.element_array_count, GL_UNSIGNED_INT, NULL);
+			QueueMeshLOD(sphereLOD, uniforms, sphere_level);
 
+			DrawScene(color);
 		}
 		else if (Globals.key == GLFW_KEY_Y)
 		{
 			glClearColor(0, 0, 0, 1);
-			glUseProgram(creative);
+			glUseProgram(creative.id);
+			DrawUniforms uniforms;
+			uniforms.squiggle = SquiggleUniform(no_squiggle);
 			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-			auto mouse_location = glGetUniformLocation(creative, "u_mouse_position");
-			auto color_location = glGetUniformLocation(creative, "u_color");
-			auto u_transform_location = glGetUniformLocation(creative, "u_transform");
 
 			glm::dvec2 normalized_mouse = Globals.mouse_position / glm::dvec2(Globals.screen_dimensions);
 			normalized_mouse.y = 1. - normalized_mouse.y;
@@ -718,6 +1176,7 @@ void main()
 			normalized_mouse.y = normalized_mouse.y * 2. - 1.;
 			glm::dvec2 badMouse = -normalized_mouse;
 
+			GLsizei frame_triangles = 0;
 			for (int i = 0; i < 18; i++)
 			{
 				chasing_pos_list[i] = glm::mix(normalized_mouse, chasing_pos_list[i], 0.99-(i*0.003+0.001));
@@ -726,11 +1185,9 @@ void main()
 				transform = glm::scale(transform, glm::vec3(0.17));
 				transform = glm::rotate(transform, float(glm::radians(90.)), glm::vec3(1, 0, 0));
 				transform = glm::rotate(transform, float(glfwGetTime() * glm::radians(30.)), glm::vec3(0, 1, 0));
-				glUniformMatrix4fv(u_transform_location, 1, GL_FALSE, glm::value_ptr(transform));
-				glUniform2fv(mouse_location, 1, glm::value_ptr(glm::vec2(normalized_mouse)));
-				glUniform3fv(color_location, 1, glm::value_ptr(glm::vec3(1)));
-				glBindVertexArray(flowerVAO.id);
-				glDrawElements(GL_TRIANGLES, flowerVAO.element_array_count, GL_UNSIGNED_INT, NULL);
+				uniforms.transform = transform;
+				uniforms.color = glm::vec3(1);
+				frame_triangles += QueueMeshLOD(flowerLOD, uniforms, flower_levels[i]);
 
 				chasing_pos_list[i+18] = glm::mix(badMouse, chasing_pos_list[i+18], 0.99 - (i*0.003 + 0.001));
 				glm::mat4 transform2(1.0);
@@ -738,20 +1195,70 @@ void main()
 				transform2 = glm::scale(transform2, glm::vec3(0.17));
 				transform2 = glm::rotate(transform2, float(glm::radians(90.)), glm::vec3(1, 0, 0));
 				transform2 = glm::rotate(transform2, float(glfwGetTime() * glm::radians(30.)), glm::vec3(0, 1, 0));
-				glUniformMatrix4fv(u_transform_location, 1, GL_FALSE, glm::value_ptr(transform2));
-				glUniform2fv(mouse_location, 1, glm::value_ptr(glm::vec2(badMouse)));
-				glUniform3fv(color_location, 1, glm::value_ptr(glm::vec3(1, 0, 0)));
-				glDrawElements(GL_TRIANGLES, flowerVAO.element_array_count, GL_UNSIGNED_INT, NULL);
+				uniforms.transform = transform2;
+				uniforms.color = glm::vec3(1, 0, 0);
+				frame_triangles += QueueMeshLOD(flowerLOD, uniforms, flower_levels[i + 18]);
 			}
 
+			DrawScene(creative);
+
+			flower_triangles_min = flower_frames == 0 ? frame_triangles : std::min(flower_triangles_min, frame_triangles);
+			flower_triangles_max = std::max(flower_triangles_max, frame_triangles);
+			flower_triangles += frame_triangles;
+			flower_frames++;
 		}
+		frame_stream.EndFrame();
+
 		/* Swap front and back buffers */
 		glfwSwapBuffers(window);
 
+		// From glfwInit, so window and context creation count too. The cache is
+		// cold when every mesh had to be generated, warm when none did.
+		if (print_statistics && frame_stream.Statistics().frames == 1)
+		{
+			const char* cache = generated_mesh_count == 0 ? "warm" : cached_mesh_count == 0 ? "cold" : "partly warm";
+			std::cout << "First frame: " << glfwGetTime() * 1000 << " ms, " << cache << " mesh cache ("
+				<< cached_mesh_count << " meshes mapped, " << generated_mesh_count << " generated)" << std::endl;
+		}
+
 		/* Poll for and process events */
 		glfwPollEvents();
 	}
 
+	/* Release the meshes while the context is current */
+	DeleteProceduralShape(sphere_shape);
+	DeleteProceduralShape(torus_shape);
+	DeleteProceduralShape(sqiggle_shape);
+	DeleteProceduralShape(sqiggle2_shape);
+	DeleteProceduralShape(sphere_patches);
+	DeleteProceduralShape(torus_patches);
+	DeleteProceduralShape(sqiggle_patches);
+	DeleteProceduralShape(sqiggle2_patches);
+	sphereLOD = MeshLOD();
+	torusLOD = MeshLOD();
+	sqiggleLOD = MeshLOD();
+	sqiggle2LOD = MeshLOD();
+	flowerLOD = MeshLOD();
+	wave_sqiggleLOD = MeshLOD();
+	wave_sqiggle2LOD = MeshLOD();
+	DeleteGeometryArena(float_arena);
+	DeleteGeometryArena(compressed_arena);
+
+	if (print_statistics)
+	{
+		const auto& stream_statistics = frame_stream.Statistics();
+		std::cout << "Streamed: " << stream_statistics.bytes_total / 1024 << " KiB over " << stream_statistics.frames << " frames, "
+			<< stream_statistics.stalls << " stalls, " << stream_statistics.overflows << " overflows"
+			<< (frame_stream.persistent ? "" : " (orphaning)") << std::endl;
+		if (flower_frames > 0)
+		{
+			std::cout << "LOD: " << flower_triangles / flower_frames << " triangles per Y scene frame on average ("
+				<< flower_triangles_min << " to " << flower_triangles_max << ") over " << flower_frames << " frames, "
+				<< flower_finest_triangles << " at the finest level" << std::endl;
+		}
+	}
+	DeleteStreamBuffer(frame_stream);
+
 	glfwTerminate();
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,337 @@
+#include "mesh_cache.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <direct.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/* Mesh Cache */
+
+const char* MeshCacheDirectory = "mesh_cache";
+
+// header_size catches a change to this struct that forgot the version bump
+struct MeshCacheHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t header_size;
+	char key[96];
+	uint64_t vertex_count;
+	uint64_t index_count;
+	float bounding_radius;
+	uint32_t reserved[3];
+};
+
+static const char MeshCacheMagic[8] = { 'P', 'A', 'R', 'M', 'E', 'S', 'H', 0 };
+
+static_assert(sizeof(MeshCacheHeader) % 16 == 0, "mesh cache arrays must stay aligned after the header");
+
+static uint64_t MeshCacheFileSize(uint64_t vertex_count, uint64_t index_count)
+{
+	return sizeof(MeshCacheHeader) + vertex_count * 2 * sizeof(glm::vec3) + index_count * sizeof(GLuint);
+}
+
+static std::string MeshCachePath(const std::string& name)
+{
+	return std::string(MeshCacheDirectory) + "/" + name + ".mesh";
+}
+
+std::string MeshCacheKey::Name() const
+{
+	if (profile.empty())
+		return std::string();
+
+	std::string name = profile + "_" + std::to_string(vertical_segments) + "x" + std::to_string(rotation_segments);
+	if (squiggle)
+		name += "_squiggle";
+	if (adaptive)
+	{
+		char tolerance_name[32];
+		std::snprintf(tolerance_name, sizeof(tolerance_name), "_adaptive%.6e", tolerance);
+		name += tolerance_name;
+	}
+	if (streamed)
+		name += "_streamed";
+	name += topology == ParametricTopology::TriangleStrip ? "_strip" : "_list";
+	name += double_precision ? "_double" : "_float";
+
+	// The header keeps it with a terminator
+	if (name.size() >= sizeof(MeshCacheHeader::key))
+		return std::string();
+	return name;
+}
+
+MappedMeshFile::~MappedMeshFile()
+{
+	Close();
+}
+
+// The view keeps the mapping alive on both platforms, so only the view is
+// held on to
+bool MappedMeshFile::Open(const MeshCacheKey& key)
+{
+	Close();
+
+	std::string name = key.Name();
+	if (name.empty())
+		return false;
+	std::string path = MeshCachePath(name);
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size) || uint64_t(file_size.QuadPart) < sizeof(MeshCacheHeader))
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+	if (mapping == NULL)
+		return false;
+
+	view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	if (view == NULL)
+	{
+		view = nullptr;
+		return false;
+	}
+	view_size = size_t(file_size.QuadPart);
+#else
+	int file = open(path.c_str(), O_RDONLY);
+	if (file < 0)
+		return false;
+
+	struct stat file_stat;
+	if (fstat(file, &file_stat) != 0 || uint64_t(file_stat.st_size) < sizeof(MeshCacheHeader))
+	{
+		close(file);
+		return false;
+	}
+
+	void* mapped = mmap(NULL, size_t(file_stat.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+	if (mapped == MAP_FAILED)
+		return false;
+
+	view = mapped;
+	view_size = size_t(file_stat.st_size);
+#endif
+
+	auto header = static_cast<const MeshCacheHeader*>(view);
+	bool valid =
+		std::memcmp(header->magic, MeshCacheMagic, sizeof(MeshCacheMagic)) == 0 &&
+		header->version == MeshCacheVersion &&
+		header->header_size == sizeof(MeshCacheHeader) &&
+		std::strncmp(header->key, name.c_str(), sizeof(header->key)) == 0 &&
+		MeshCacheFileSize(header->vertex_count, header->index_count) == view_size;
+	if (!valid)
+	{
+		Close();
+		return false;
+	}
+
+	vertex_count = size_t(header->vertex_count);
+	index_count = size_t(header->index_count);
+	bounding_radius = header->bounding_radius;
+	positions = reinterpret_cast<const glm::vec3*>(header + 1);
+	normals = positions + vertex_count;
+	indices = reinterpret_cast<const GLuint*>(normals + vertex_count);
+
+	// A stale or corrupt file must not send the GPU past the vertices. Strips
+	// may also hold the restart index, lists never do.
+	bool strips = key.topology == ParametricTopology::TriangleStrip;
+	for (size_t i = 0; i < index_count; ++i)
+	{
+		if (indices[i] >= vertex_count && !(strips && indices[i] == ParametricPrimitiveRestartIndex))
+		{
+			std::cout << "Warning: Mesh cache file " << name << " has an index past its vertices, generating it again" << std::endl;
+			Close();
+			return false;
+		}
+	}
+	return true;
+}
+
+void MappedMeshFile::Close()
+{
+	if (view)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(view);
+#else
+		munmap(view, view_size);
+#endif
+	}
+
+	view = nullptr;
+	view_size = 0;
+	positions = nullptr;
+	normals = nullptr;
+	indices = nullptr;
+	vertex_count = 0;
+	index_count = 0;
+	bounding_radius = 0;
+}
+
+bool WriteMeshCache(
+	const MeshCacheKey& key,
+	const std::vector<glm::vec3>& positions,
+	const std::vector<glm::vec3>& normals,
+	const std::vector<GLuint>& indices,
+	float bounding_radius
+)
+{
+	std::string name = key.Name();
+	if (name.empty() || positions.size() != normals.size())
+		return false;
+
+	// Fails harmlessly when the directory is already there
+#ifdef _WIN32
+	_mkdir(MeshCacheDirectory);
+#else
+	mkdir(MeshCacheDirectory, 0755);
+#endif
+
+	MeshCacheHeader header = {};
+	std::memcpy(header.magic, MeshCacheMagic, sizeof(MeshCacheMagic));
+	header.version = MeshCacheVersion;
+	header.header_size = sizeof(MeshCacheHeader);
+	std::strncpy(header.key, name.c_str(), sizeof(header.key) - 1);
+	header.vertex_count = positions.size();
+	header.index_count = indices.size();
+	header.bounding_radius = bounding_radius;
+
+	std::string path = MeshCachePath(name);
+	std::string temporary_path = path + ".tmp";
+	{
+		std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(positions.data()), std::streamsize(positions.size() * sizeof(glm::vec3)));
+		file.write(reinterpret_cast<const char*>(normals.data()), std::streamsize(normals.size() * sizeof(glm::vec3)));
+		file.write(reinterpret_cast<const char*>(indices.data()), std::streamsize(indices.size() * sizeof(GLuint)));
+		file.close();
+
+		if (!file)
+		{
+			std::remove(temporary_path.c_str());
+			return false;
+		}
+	}
+
+	// rename doesn't replace an existing file on Windows
+	std::remove(path.c_str());
+	if (std::rename(temporary_path.c_str(), path.c_str()) != 0)
+	{
+		std::remove(temporary_path.c_str());
+		return false;
+	}
+	return true;
+}
+
+// The arrays of a tile land at their place in each of the three sections of
+// the file, so the tiles only have to come in order for the header
+ParametricMeshSink CreateMeshCacheSink(const MeshCacheKey& key)
+{
+	struct Stream
+	{
+		std::string name;
+		std::ofstream file;
+		std::vector<GLuint> indices;
+		uint64_t vertex_count;
+	};
+
+	// Shared between the copies of the sink
+	auto stream = std::make_shared<Stream>();
+	stream->name = key.Name();
+
+	return [stream](const ParametricMeshTile& tile)
+	{
+		std::string path = MeshCachePath(stream->name);
+		std::string temporary_path = path + ".tmp";
+
+		if (tile.first_vertex == 0 && tile.first_index == 0)
+		{
+			if (stream->name.empty() || tile.total_vertex_count > 0xFFFFFFFFull)
+				return false;
+
+#ifdef _WIN32
+			_mkdir(MeshCacheDirectory);
+#else
+			mkdir(MeshCacheDirectory, 0755);
+#endif
+
+			MeshCacheHeader header = {};
+			std::memcpy(header.magic, MeshCacheMagic, sizeof(MeshCacheMagic));
+			header.version = MeshCacheVersion;
+			header.header_size = sizeof(MeshCacheHeader);
+			std::strncpy(header.key, stream->name.c_str(), sizeof(header.key) - 1);
+			header.vertex_count = tile.total_vertex_count;
+			header.index_count = tile.total_index_count;
+			header.bounding_radius = tile.bounding_radius;
+
+			stream->vertex_count = tile.total_vertex_count;
+			stream->file.open(temporary_path, std::ios::binary | std::ios::trunc);
+			stream->file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		}
+
+		uint64_t positions_offset = sizeof(MeshCacheHeader);
+		uint64_t normals_offset = positions_offset + stream->vertex_count * sizeof(glm::vec3);
+		uint64_t indices_offset = normals_offset + stream->vertex_count * sizeof(glm::vec3);
+
+		stream->indices.assign(tile.indices, tile.indices + size_t(tile.index_count));
+
+		auto& file = stream->file;
+		file.seekp(std::streamoff(positions_offset + tile.first_vertex * sizeof(glm::vec3)));
+		file.write(reinterpret_cast<const char*>(tile.positions), std::streamsize(tile.vertex_count * sizeof(glm::vec3)));
+		file.seekp(std::streamoff(normals_offset + tile.first_vertex * sizeof(glm::vec3)));
+		file.write(reinterpret_cast<const char*>(tile.normals), std::streamsize(tile.vertex_count * sizeof(glm::vec3)));
+		file.seekp(std::streamoff(indices_offset + tile.first_index * sizeof(GLuint)));
+		file.write(reinterpret_cast<const char*>(stream->indices.data()), std::streamsize(tile.index_count * sizeof(GLuint)));
+
+		if (!file)
+		{
+			file.close();
+			std::remove(temporary_path.c_str());
+			return false;
+		}
+
+		if (!tile.last)
+			return true;
+
+		file.close();
+		if (!file)
+		{
+			std::remove(temporary_path.c_str());
+			return false;
+		}
+
+		// rename doesn't replace an existing file on Windows
+		std::remove(path.c_str());
+		if (std::rename(temporary_path.c_str(), path.c_str()) != 0)
+		{
+			std::remove(temporary_path.c_str());
+			return false;
+		}
+		return true;
+	};
+}
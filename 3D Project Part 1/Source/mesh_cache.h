@@ -0,0 +1,89 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "GLM/glm.hpp"
+#include "GLAD/glad.h"
+#include "mesh_generation.h"
+
+/* Mesh Cache */
+
+// Generated meshes are kept in MeshCacheDirectory, one file per key, and
+// memory-mapped on later runs instead of being generated again. A file holds
+// a header, then the positions, normals and indices exactly as they go into
+// the VAO, so a hit is a copy from the mapping into the GL buffers.
+//
+// Bump MeshCacheVersion whenever the generators, the pole welding or the
+// optimization stage change what a key produces; files written by any other
+// version are ignored and overwritten. Version 2 added the tolerance and the
+// grid precision to the key.
+const unsigned MeshCacheVersion = 2;
+
+extern const char* MeshCacheDirectory;
+
+// Everything that decides the generated mesh. profile is the
+// FindParametricLineName of the profile; a profile without a name can't be
+// cached.
+struct MeshCacheKey
+{
+	std::string profile;
+	int vertical_segments = 0;
+	int rotation_segments = 0;
+	bool squiggle = false;
+	bool adaptive = false;
+	// Chord error the adaptive sampling is held to, unused otherwise
+	double tolerance = 0;
+	// Sampled in a ParametricSampleGrid rather than a FloatParametricSampleGrid
+	bool double_precision = false;
+	// Written by CreateMeshCacheSink, without the optimization stage
+	bool streamed = false;
+	ParametricTopology topology = ParametricTopology::TriangleList;
+
+	// File name in MeshCacheDirectory, also stored in the header to check
+	// against. Empty when the key can't be cached.
+	std::string Name() const;
+};
+
+// A cache file mapped read-only. The arrays point into the mapping and stay
+// valid until the file is closed or another one is opened.
+struct MappedMeshFile
+{
+	const glm::vec3* positions = nullptr;
+	const glm::vec3* normals = nullptr;
+	const GLuint* indices = nullptr;
+	size_t vertex_count = 0;
+	size_t index_count = 0;
+	float bounding_radius = 0;
+
+	MappedMeshFile() = default;
+	MappedMeshFile(const MappedMeshFile&) = delete;
+	MappedMeshFile& operator=(const MappedMeshFile&) = delete;
+	~MappedMeshFile();
+
+	// False when there is no file for the key, or it is from another version
+	// or damaged, an index past the vertices included; the caller generates
+	// the mesh and writes it then.
+	bool Open(const MeshCacheKey& key);
+	void Close();
+
+private:
+	void* view = nullptr;
+	size_t view_size = 0;
+};
+
+// Writes through a temporary file and renames it into place, so a run that
+// dies halfway never leaves a truncated entry behind. False if the mesh
+// couldn't be written; the cache is only an optimization, so callers carry on.
+bool WriteMeshCache(
+	const MeshCacheKey& key,
+	const std::vector<glm::vec3>& positions,
+	const std::vector<glm::vec3>& normals,
+	const std::vector<GLuint>& indices,
+	float bounding_radius
+);
+
+// Sink that writes a streamed mesh to the cache file of key, a tile at a time
+// at each tile's offsets in the file, through the same temporary file and
+// rename as WriteMeshCache. Stops the generator if the file can't be written
+// or the mesh needs more than 32-bit indices.
+ParametricMeshSink CreateMeshCacheSink(const MeshCacheKey& key);
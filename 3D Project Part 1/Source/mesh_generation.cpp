@@ -1,124 +1,954 @@
 #include "mesh_generation.h"
+#include "simd_math.h"
 
-/* Generator Functions */
-void GenerateParametricShapeFrom2D(
+#include "GLM/gtx/component_wise.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <thread>
+
+/* Generator Helpers */
+void ParallelForRange(int begin, int end, unsigned thread_count, const std::function<void(int, int)>& body)
+{
+	if (thread_count == 0)
+		thread_count = std::max(1u, std::thread::hardware_concurrency());
+	thread_count = std::min(thread_count, unsigned(std::max(end - begin, 1)));
+
+	if (thread_count == 1)
+	{
+		body(begin, end);
+		return;
+	}
+
+	auto ChunkBegin = [begin, end, thread_count](unsigned i)
+	{
+		return begin + int((long long)(end - begin) * i / thread_count);
+	};
+
+	std::vector<std::thread> workers;
+	workers.reserve(thread_count - 1);
+	for (unsigned i = 0; i < thread_count - 1; ++i)
+		workers.emplace_back(body, ChunkBegin(i), ChunkBegin(i + 1));
+
+	body(ChunkBegin(thread_count - 1), end);
+
+	for (auto& worker : workers)
+		worker.join();
+}
+
+/* Mesh Layout */
+void ParametricVertexLayout::Reset(int vertical_segments, int rotation_segments)
+{
+	this->vertical_segments = vertical_segments;
+	this->rotation_segments = rotation_segments;
+	pole_rows.assign(vertical_segments, 0);
+	Update();
+}
+
+void ParametricVertexLayout::Update()
+{
+	row_indices.resize(vertical_segments);
+	ring_rows = 0;
+	pole_count = 0;
+
+	for (int v = 0; v < vertical_segments; ++v)
+		row_indices[v] = pole_rows[v] ? pole_count++ : ring_rows++;
+}
+
+uint64_t ParametricVertexLayout::VertexCount() const
+{
+	return uint64_t(ring_rows) * rotation_segments + pole_count;
+}
+
+uint64_t ParametricVertexLayout::IndexCount(ParametricTopology topology) const
+{
+	if (topology == ParametricTopology::TriangleStrip)
+		return (uint64_t(vertical_segments) * 2 + 1) * rotation_segments - 1;
+
+	// One triangle per quad for every end of the quad that isn't a pole
+	uint64_t column_triangles = 0;
+	for (int v = 0; v < vertical_segments - 1; ++v)
+		column_triangles += !pole_rows[v] + !pole_rows[v + 1];
+	return column_triangles * 3 * rotation_segments;
+}
+
+/* Generator Output */
+ParametricMeshOutput AppendParametricMeshOutput(
 	std::vector<glm::vec3>& positions,
 	std::vector<glm::vec3>& normals,
 	std::vector<GLuint>& indices,
-	glm::dvec2(*parametric_line)(double),
-	int vertical_segments,
-	int rotation_segments,
-	bool squiggle
+	const ParametricVertexLayout& layout,
+	ParametricTopology topology
 )
 {
-	auto parametric_surface = [parametric_line, squiggle](double t, double r)
+	size_t vertex_offset = positions.size();
+	size_t index_offset = indices.size();
+	positions.resize(vertex_offset + size_t(layout.VertexCount()));
+	normals.resize(vertex_offset + size_t(layout.VertexCount()));
+	indices.resize(index_offset + size_t(layout.IndexCount(topology)));
+
+	return ParametricMeshOutput{ positions.data() + vertex_offset, normals.data() + vertex_offset, indices.data() + index_offset };
+}
+
+// Two triangles per quad between rotation columns r and r + 1 for the columns
+// in [column_begin, column_end), each column writing its own slice of
+// indices. (v, r) and (v, r + 1) are the same vertex on a pole row, so the
+// triangle using both is dropped.
+template <typename Index>
+static void BuildParametricListIndices(
+	Index* indices,
+	const ParametricVertexLayout& layout,
+	int column_begin,
+	int column_end,
+	const ParametricShapeOptions& options
+)
+{
+	size_t column_indices = size_t(layout.IndexCount(ParametricTopology::TriangleList) / layout.rotation_segments);
+
+	ParallelForRange(column_begin, column_end, options.thread_count, [&](int r_begin, int r_end)
 	{
-		auto p = glm::dvec3(parametric_line(t), 0);
+		for (int r = r_begin; r < r_end; ++r)
+		{
+			auto column_index = indices + column_indices * (r - column_begin);
+			for (int v = 0; v < layout.vertical_segments - 1; ++v)
+			{
+				if (!layout.pole_rows[v])
+				{
+					*column_index++ = Index(layout.VertexIndex64(v + 1, r));
+					*column_index++ = Index(layout.VertexIndex64(v, r + 1));
+					*column_index++ = Index(layout.VertexIndex64(v, r));
+				}
+
+				if (!layout.pole_rows[v + 1])
+				{
+					*column_index++ = Index(layout.VertexIndex64(v + 1, r));
+					*column_index++ = Index(layout.VertexIndex64(v + 1, r + 1));
+					*column_index++ = Index(layout.VertexIndex64(v, r + 1));
+				}
+			}
+		}
+	});
+}
 
-		if (squiggle)
+// One strip per column zigzagging (v, r + 1), (v, r), each followed by a
+// restart index except the last
+static void BuildParametricStripIndices(
+	GLuint* indices,
+	const ParametricVertexLayout& layout,
+	const ParametricShapeOptions& options
+)
+{
+	int rotation_segments = layout.rotation_segments;
+	size_t column_indices = size_t(layout.vertical_segments) * 2 + 1;
+
+	ParallelForRange(0, rotation_segments, options.thread_count, [&](int r_begin, int r_end)
+	{
+		for (int r = r_begin; r < r_end; ++r)
 		{
-			auto s = sin(r * glm::two_pi<double>() * 6) / 2. + 1;
-			p *= s * 0.8;
+			auto column_index = indices + column_indices * r;
+			for (int v = 0; v < layout.vertical_segments; ++v)
+			{
+				*column_index++ = layout.VertexIndex(v, r + 1);
+				*column_index++ = layout.VertexIndex(v, r);
+			}
+
+			if (r < rotation_segments - 1)
+				*column_index = ParametricPrimitiveRestartIndex;
 		}
+	});
+}
 
-		return glm::rotateY(p, r * glm::two_pi<double>());
+static void BuildParametricIndices(
+	GLuint* indices,
+	const ParametricVertexLayout& layout,
+	const ParametricShapeOptions& options
+)
+{
+	if (options.topology == ParametricTopology::TriangleStrip)
+		BuildParametricStripIndices(indices, layout, options);
+	else
+		BuildParametricListIndices(indices, layout, 0, layout.rotation_segments, options);
+}
+
+// What the poles need from the ring columns: their position and the normal of
+// their neighbour rows at column 0, and those normals summed over every
+// column. Gathered by BuildParametricRingVertices, so the poles can be written
+// after the columns went by a range at a time.
+template <typename T>
+struct ParametricPoleNormals
+{
+	typedef glm::vec<3, T, glm::defaultp> Vec3;
+
+	std::vector<Vec3> positions;
+	std::vector<Vec3> first_normals;
+	std::vector<Vec3> normal_sums;
+};
+
+// Unit normal, or zero where the tangents are (nearly) parallel. Tangents are
+// rescaled first so that near-axis crosses don't normalize from denormals.
+template <typename T>
+static glm::vec<3, T, glm::defaultp> ParametricUnitNormal(const glm::vec<3, T, glm::defaultp>& tangent_r, const glm::vec<3, T, glm::defaultp>& tangent_v)
+{
+	typedef glm::vec<3, T, glm::defaultp> Vec3;
+
+	auto Rescale = [](const Vec3& tangent)
+	{
+		T extent = glm::compMax(glm::abs(tangent));
+		return extent > 0 ? tangent / extent : tangent;
 	};
 
-	positions.reserve(vertical_segments * rotation_segments);
-	for (int r = 0; r < rotation_segments; ++r)
-		for (int v = 0; v < vertical_segments; ++v)
-			positions.push_back(parametric_surface(v / double(vertical_segments - 1), r / double(rotation_segments)));
+	Vec3 scaled_r = Rescale(tangent_r), scaled_v = Rescale(tangent_v);
+	auto normal = glm::cross(scaled_r, scaled_v);
+	T tolerance = 16 * std::numeric_limits<T>::epsilon() * glm::length(scaled_r) * glm::length(scaled_v);
+	return glm::length(normal) > tolerance ? glm::normalize(normal) : Vec3(0);
+}
 
-	normals.reserve(vertical_segments * rotation_segments);
-	for (int r = 0; r < rotation_segments; ++r)
-		for (int v = 0; v < vertical_segments; ++v)
+// Writes the ring vertices of the columns in [column_begin, column_end) from
+// surface_point(v, r, position, tangent_r, tangent_v), column r starting at
+// positions[(r - column_begin) * ring_rows], and adds the columns to poles.
+// Ranges must come in order from column 0.
+//
+// Where the two tangents are parallel (on the axis, at an extremum of the
+// profile radius) the normal is the average of the rows above and below. A
+// pole gets the average normal of its whole neighbour rings.
+template <typename T, typename SurfacePoint>
+static void BuildParametricRingVertices(
+	glm::vec3* positions,
+	glm::vec3* normals,
+	const ParametricVertexLayout& layout,
+	const SurfacePoint& surface_point,
+	int column_begin,
+	int column_end,
+	ParametricPoleNormals<T>& poles,
+	const ParametricShapeOptions& options
+)
+{
+	typedef glm::vec<3, T, glm::defaultp> Vec3;
+
+	int vertical_segments = layout.vertical_segments;
+
+	auto SurfaceNormal = [&](int v, int r)
+	{
+		Vec3 position, tangent_r, tangent_v;
+		surface_point(v, r, position, tangent_r, tangent_v);
+		return ParametricUnitNormal(tangent_r, tangent_v);
+	};
+
+	auto NeighbourNormal = [&](int v, int r)
+	{
+		Vec3 normal(0);
+		if (v > 0 && !layout.pole_rows[v - 1])
+			normal += SurfaceNormal(v - 1, r);
+		if (v < vertical_segments - 1 && !layout.pole_rows[v + 1])
+			normal += SurfaceNormal(v + 1, r);
+		return normal;
+	};
+
+	// Every rotation column owns a fixed slice of each output array, so
+	// columns can be filled in any order and on any thread.
+	ParallelForRange(column_begin, column_end, options.thread_count, [&](int r_begin, int r_end)
+	{
+		for (int r = r_begin; r < r_end; ++r)
 		{
-			auto nv = v / double(vertical_segments - 1);
-			auto nr = r / double(rotation_segments);
-			auto epsilonv = 1 / double(vertical_segments - 1);
-			auto epsilonr = 1 / double(rotation_segments);
+			auto column_positions = positions + size_t(r - column_begin) * layout.ring_rows;
+			auto column_normals = normals + size_t(r - column_begin) * layout.ring_rows;
+			for (int v = 0; v < vertical_segments; ++v)
+			{
+				if (layout.pole_rows[v])
+					continue;
 
-			auto to_next_v = parametric_surface(nv + epsilonv, nr) - parametric_surface(nv, nr);
-			auto from_prev_v = parametric_surface(nv, nr) - parametric_surface(nv - epsilonv, nr);
-			auto tangent_v = (to_next_v + from_prev_v) / 2.;
+				Vec3 position, tangent_r, tangent_v;
+				surface_point(v, r, position, tangent_r, tangent_v);
 
-			auto to_next_r = parametric_surface(nv, nr + epsilonr) - parametric_surface(nv, nr);
-			auto from_prev_r = parametric_surface(nv, nr) - parametric_surface(nv, nr - epsilonr);
-			auto tangent_r = (to_next_r + from_prev_r) / 2.;
+				auto normal = ParametricUnitNormal(tangent_r, tangent_v);
+				if (normal == Vec3(0))
+				{
+					normal = NeighbourNormal(v, r);
+					normal = normal == Vec3(0) ? Vec3(0, 1, 0) : glm::normalize(normal);
+				}
 
-			auto normal = glm::normalize(glm::cross(tangent_r, tangent_v));
-			normals.push_back(normal);
+				column_positions[layout.row_indices[v]] = glm::vec3(position);
+				column_normals[layout.row_indices[v]] = glm::vec3(normal);
+			}
 		}
+	});
 
-	auto VRtoIndex = [vertical_segments, rotation_segments](int v, int r)
+	// Summed on one thread, column by column, so the poles come out the same
+	// however the columns were split
+	if (column_begin == 0)
 	{
-		return (r % rotation_segments) * vertical_segments + v;
-	};
-	indices.reserve(rotation_segments * (vertical_segments - 1) * 6);
-	for (int r = 0; r < rotation_segments; ++r)
-		for (int v = 0; v < vertical_segments - 1; ++v)
-		{
-			indices.push_back(VRtoIndex(v + 1, r));
-			indices.push_back(VRtoIndex(v, r + 1));
-			indices.push_back(VRtoIndex(v, r));
+		poles.positions.assign(layout.pole_count, Vec3(0));
+		poles.first_normals.assign(layout.pole_count, Vec3(0));
+		poles.normal_sums.assign(layout.pole_count, Vec3(0));
+	}
 
-			indices.push_back(VRtoIndex(v + 1, r));
-			indices.push_back(VRtoIndex(v + 1, r + 1));
-			indices.push_back(VRtoIndex(v, r + 1));
+	for (int v = 0; v < vertical_segments; ++v)
+	{
+		if (!layout.pole_rows[v])
+			continue;
+
+		auto pole = layout.row_indices[v];
+		if (column_begin == 0 && column_end > 0)
+		{
+			Vec3 tangent_r, tangent_v;
+			surface_point(v, 0, poles.positions[pole], tangent_r, tangent_v);
+			poles.first_normals[pole] = NeighbourNormal(v, 0);
 		}
+
+		for (int r = column_begin; r < column_end; ++r)
+			poles.normal_sums[pole] += r == 0 ? poles.first_normals[pole] : NeighbourNormal(v, r);
+	}
 }
 
-void GenerateParametricShapeFrom3D(
+// Writes the pole vertices gathered over every column, pole i at positions[i]
+template <typename T>
+static void BuildParametricPoleVertices(
+	glm::vec3* positions,
+	glm::vec3* normals,
+	const ParametricVertexLayout& layout,
+	const ParametricPoleNormals<T>& poles
+)
+{
+	typedef glm::vec<3, T, glm::defaultp> Vec3;
+
+	for (int pole = 0; pole < layout.pole_count; ++pole)
+	{
+		Vec3 normal = poles.normal_sums[pole];
+
+		// Opposite cones meeting at a pinch can cancel out completely
+		if (glm::length(normal) <= 16 * std::numeric_limits<T>::epsilon() * layout.rotation_segments)
+			normal = poles.first_normals[pole];
+
+		positions[pole] = glm::vec3(poles.positions[pole]);
+		normals[pole] = glm::vec3(normal == Vec3(0) ? Vec3(0, 1, 0) : glm::normalize(normal));
+	}
+}
+
+// Every vertex and index of the layout, the rings column by column, then the
+// poles
+template <typename T, typename SurfacePoint>
+static void BuildParametricMesh(
+	const ParametricMeshOutput& output,
+	const ParametricVertexLayout& layout,
+	const SurfacePoint& surface_point,
+	const ParametricShapeOptions& options
+)
+{
+	size_t ring_vertex_count = size_t(layout.ring_rows) * layout.rotation_segments;
+
+	ParametricPoleNormals<T> poles;
+	BuildParametricRingVertices<T>(output.positions, output.normals, layout, surface_point, 0, layout.rotation_segments, poles, options);
+	BuildParametricPoleVertices(output.positions + ring_vertex_count, output.normals + ring_vertex_count, layout, poles);
+	BuildParametricIndices(output.indices, layout, options);
+}
+
+template <typename T>
+void FindParametricGridPoles(BasicParametricSampleGrid<T>& grid)
+{
+	auto& layout = grid.layout;
+	layout.Reset(grid.vertical_segments, grid.rotation_segments);
+
+	T extent = 0;
+	for (int r = 0; r < grid.rotation_segments; ++r)
+		for (int v = 0; v < grid.vertical_segments; ++v)
+			extent = std::max(extent, glm::compMax(glm::abs(grid.At(v, r))));
+	T tolerance = 16 * std::numeric_limits<T>::epsilon() * extent;
+
+	for (int v = 0; v < grid.vertical_segments; ++v)
+	{
+		T spread = 0;
+		for (int r = 1; r < grid.rotation_segments; ++r)
+			spread = std::max(spread, glm::compMax(glm::abs(grid.At(v, r) - grid.At(v, 0))));
+		layout.pole_rows[v] = spread <= tolerance;
+	}
+
+	layout.Update();
+}
+
+template <typename T>
+void BuildParametricShapeFromGrid(
+	const ParametricMeshOutput& output,
+	const BasicParametricSampleGrid<T>& grid,
+	const ParametricShapeOptions& options
+)
+{
+	typedef typename BasicParametricSampleGrid<T>::Vec3 Vec3;
+
+	auto SurfacePoint = [&grid](int v, int r, Vec3& position, Vec3& tangent_r, Vec3& tangent_v)
+	{
+		position = grid.At(v, r);
+		tangent_v = (grid.At(v + 1, r) - grid.At(v - 1, r)) / T(2);
+		tangent_r = (grid.At(v, r + 1) - grid.At(v, r - 1)) / T(2);
+	};
+
+	BuildParametricMesh<T>(output, grid.layout, SurfacePoint, options);
+}
+
+template <typename T>
+void BuildParametricShapeFromGrid(
 	std::vector<glm::vec3>& positions,
 	std::vector<glm::vec3>& normals,
 	std::vector<GLuint>& indices,
-	glm::dvec3(*parametric_surface)(double, double),
-	int vertical_segments,
-	int rotation_segments
+	const BasicParametricSampleGrid<T>& grid,
+	const ParametricShapeOptions& options
 )
 {
-	positions.reserve(vertical_segments * rotation_segments);
-	for (int r = 0; r < rotation_segments; ++r)
-		for (int v = 0; v < vertical_segments; ++v)
-			positions.push_back(parametric_surface(v / double(vertical_segments - 1), r / double(rotation_segments)));
+	auto output = AppendParametricMeshOutput(positions, normals, indices, grid.layout, options.topology);
+	BuildParametricShapeFromGrid(output, grid, options);
+}
+
+// The table is O(rotation_segments), so it is always computed in double and
+// only stored at the grid precision.
+static BasicParametricRotation<double> EvaluateParametricRotation(double nr, bool squiggle)
+{
+	BasicParametricRotation<double> rotation;
+	rotation.cos_angle = cos(nr * glm::two_pi<double>());
+	rotation.sin_angle = sin(nr * glm::two_pi<double>());
+	rotation.scale = 1;
+	rotation.scale_derivative = 0;
+
+	if (squiggle)
+	{
+		ParametricSquiggle baked;
+		auto frequency = glm::two_pi<double>() * baked.frequency;
+		auto wave = nr * frequency + baked.phase;
+		rotation.scale = (sin(wave) * baked.amplitude + 1) * baked.scale;
+		rotation.scale_derivative = cos(wave) * frequency * baked.amplitude * baked.scale;
+	}
+
+	return rotation;
+}
+
+template <typename T>
+static void StoreParametricRotation(BasicParametricRotation<T>& rotation, double nr, bool squiggle)
+{
+	auto exact = EvaluateParametricRotation(nr, squiggle);
+	rotation.cos_angle = T(exact.cos_angle);
+	rotation.sin_angle = T(exact.sin_angle);
+	rotation.scale = T(exact.scale);
+	rotation.scale_derivative = T(exact.scale_derivative);
+}
+
+template <typename T>
+void SampleParametricRotations(BasicParametricSampleGrid<T>& grid, bool squiggle)
+{
+	grid.rotations.resize(grid.rotation_segments);
+
+	for (int r = 0; r < grid.rotation_segments; ++r)
+		StoreParametricRotation(grid.rotations[r], r / double(grid.rotation_segments), squiggle);
+}
+
+template <typename T>
+void SampleParametricRotations(BasicParametricSampleGrid<T>& grid, bool squiggle, const std::vector<double>& parameters)
+{
+	grid.rotation_segments = int(parameters.size());
+	grid.rotations.resize(grid.rotation_segments);
+
+	for (int r = 0; r < grid.rotation_segments; ++r)
+		StoreParametricRotation(grid.rotations[r], parameters[r], squiggle);
+}
+
+// The ring of row v is scale(r) * (x c, y, -x s): a single point when x is 0
+// and the scale doesn't move y along the axis
+template <typename T>
+static void MarkParametricRevolutionPoles(BasicParametricSampleGrid<T>& grid, T min_scale, T max_scale)
+{
+	auto& layout = grid.layout;
+	layout.Reset(grid.vertical_segments, grid.rotation_segments);
+
+	T extent = 0;
+	for (int v = 0; v < grid.vertical_segments; ++v)
+		extent = std::max(extent, glm::compMax(glm::abs(grid.ProfileAt(v))));
+	T tolerance = 16 * std::numeric_limits<T>::epsilon() * extent * max_scale;
+
+	for (int v = 0; v < grid.vertical_segments; ++v)
+	{
+		auto p = grid.ProfileAt(v);
+		layout.pole_rows[v] = std::abs(p.x) * max_scale <= tolerance && std::abs(p.y) * (max_scale - min_scale) <= tolerance;
+	}
+
+	layout.Update();
+}
+
+template <typename T>
+void FindParametricRevolutionPoles(BasicParametricSampleGrid<T>& grid)
+{
+	T min_scale = std::numeric_limits<T>::max();
+	T max_scale = 0;
+	for (auto& rotation : grid.rotations)
+	{
+		min_scale = std::min(min_scale, std::abs(rotation.scale));
+		max_scale = std::max(max_scale, std::abs(rotation.scale));
+	}
+
+	MarkParametricRevolutionPoles(grid, min_scale, max_scale);
+}
+
+// |scale(r) * (x c, y, -x s)| = |scale(r)| * |(x, y)|
+template <typename T>
+T BoundParametricShapeOfRevolution(const BasicParametricSampleGrid<T>& grid)
+{
+	T max_scale = 0;
+	for (auto& rotation : grid.rotations)
+		max_scale = std::max(max_scale, std::abs(rotation.scale));
+
+	T max_length = 0;
+	for (int v = 0; v < grid.vertical_segments; ++v)
+		max_length = std::max(max_length, glm::length(grid.ProfileAt(v)));
+
+	return max_scale * max_length;
+}
+
+// p(v, r) = scale(r) * rotateY((x(v), y(v), 0), 2 PI r), with rotation the
+// table entry of column r
+template <typename T>
+static void ParametricRevolutionPoint(
+	const BasicParametricSampleGrid<T>& grid,
+	const BasicParametricRotation<T>& rotation,
+	int v,
+	glm::vec<3, T, glm::defaultp>& position,
+	glm::vec<3, T, glm::defaultp>& tangent_r,
+	glm::vec<3, T, glm::defaultp>& tangent_v
+)
+{
+	typedef glm::vec<3, T, glm::defaultp> Vec3;
+
+	auto c = rotation.cos_angle;
+	auto s = rotation.sin_angle;
+
+	auto p = grid.ProfileAt(v);
+	auto dp = grid.ProfileTangentAt(v);
+	auto unscaled = Vec3(p.x * c, p.y, -p.x * s);
+
+	position = rotation.scale * unscaled;
+	tangent_v = Vec3(dp.x * c, dp.y, -dp.x * s);
+	tangent_r = rotation.scale_derivative * unscaled + rotation.scale * glm::two_pi<T>() * Vec3(-p.x * s, 0, -p.x * c);
+}
+
+template <typename T>
+void BuildParametricShapeOfRevolution(
+	const ParametricMeshOutput& output,
+	const BasicParametricSampleGrid<T>& grid,
+	const ParametricShapeOptions& options
+)
+{
+	typedef typename BasicParametricSampleGrid<T>::Vec3 Vec3;
+
+	auto SurfacePoint = [&grid](int v, int r, Vec3& position, Vec3& tangent_r, Vec3& tangent_v)
+	{
+		ParametricRevolutionPoint(grid, grid.rotations[r], v, position, tangent_r, tangent_v);
+	};
+
+	BuildParametricMesh<T>(output, grid.layout, SurfacePoint, options);
+}
+
+template <typename T>
+void BuildParametricShapeOfRevolution(
+	std::vector<glm::vec3>& positions,
+	std::vector<glm::vec3>& normals,
+	std::vector<GLuint>& indices,
+	const BasicParametricSampleGrid<T>& grid,
+	const ParametricShapeOptions& options
+)
+{
+	auto output = AppendParametricMeshOutput(positions, normals, indices, grid.layout, options.topology);
+	BuildParametricShapeOfRevolution(output, grid, options);
+}
+
+template void FindParametricGridPoles<double>(ParametricSampleGrid&);
+template void FindParametricGridPoles<float>(FloatParametricSampleGrid&);
+template void BuildParametricShapeFromGrid<double>(const ParametricMeshOutput&, const ParametricSampleGrid&, const ParametricShapeOptions&);
+template void BuildParametricShapeFromGrid<float>(const ParametricMeshOutput&, const FloatParametricSampleGrid&, const ParametricShapeOptions&);
+template void BuildParametricShapeFromGrid<double>(std::vector<glm::vec3>&, std::vector<glm::vec3>&, std::vector<GLuint>&, const ParametricSampleGrid&, const ParametricShapeOptions&);
+template void BuildParametricShapeFromGrid<float>(std::vector<glm::vec3>&, std::vector<glm::vec3>&, std::vector<GLuint>&, const FloatParametricSampleGrid&, const ParametricShapeOptions&);
+template void SampleParametricRotations<double>(ParametricSampleGrid&, bool);
+template void SampleParametricRotations<float>(FloatParametricSampleGrid&, bool);
+template void SampleParametricRotations<double>(ParametricSampleGrid&, bool, const std::vector<double>&);
+template void SampleParametricRotations<float>(FloatParametricSampleGrid&, bool, const std::vector<double>&);
+template void FindParametricRevolutionPoles<double>(ParametricSampleGrid&);
+template void FindParametricRevolutionPoles<float>(FloatParametricSampleGrid&);
+template double BoundParametricShapeOfRevolution<double>(const ParametricSampleGrid&);
+template float BoundParametricShapeOfRevolution<float>(const FloatParametricSampleGrid&);
+template void BuildParametricShapeOfRevolution<double>(const ParametricMeshOutput&, const ParametricSampleGrid&, const ParametricShapeOptions&);
+template void BuildParametricShapeOfRevolution<float>(const ParametricMeshOutput&, const FloatParametricSampleGrid&, const ParametricShapeOptions&);
+template void BuildParametricShapeOfRevolution<double>(std::vector<glm::vec3>&, std::vector<glm::vec3>&, std::vector<GLuint>&, const ParametricSampleGrid&, const ParametricShapeOptions&);
+template void BuildParametricShapeOfRevolution<float>(std::vector<glm::vec3>&, std::vector<glm::vec3>&, std::vector<GLuint>&, const FloatParametricSampleGrid&, const ParametricShapeOptions&);
 
-	normals.reserve(vertical_segments * rotation_segments);
+/* Streaming Generation */
+
+// The scale range and bound are found in a pass over the rotations that
+// keeps nothing, then each tile evaluates its own columns of the table, the
+// same way SampleParametricRotations would
+template <typename T>
+bool StreamParametricShapeOfRevolution(
+	BasicParametricSampleGrid<T>& grid,
+	bool squiggle,
+	const ParametricMeshSink& sink,
+	const ParametricShapeOptions& options
+)
+{
+	typedef typename BasicParametricSampleGrid<T>::Vec3 Vec3;
+
+	int rotation_segments = grid.rotation_segments;
+
+	T min_scale = std::numeric_limits<T>::max();
+	T max_scale = 0;
 	for (int r = 0; r < rotation_segments; ++r)
-		for (int v = 0; v < vertical_segments; ++v)
-		{
-			auto nv = v / double(vertical_segments - 1);
-			auto nr = r / double(rotation_segments);
-			auto epsilonv = 1 / double(vertical_segments - 1);
-			auto epsilonr = 1 / double(rotation_segments);
+	{
+		T scale = std::abs(T(EvaluateParametricRotation(r / double(rotation_segments), squiggle).scale));
+		min_scale = std::min(min_scale, scale);
+		max_scale = std::max(max_scale, scale);
+	}
+
+	MarkParametricRevolutionPoles(grid, min_scale, max_scale);
+	auto& layout = grid.layout;
+
+	T max_length = 0;
+	for (int v = 0; v < grid.vertical_segments; ++v)
+		max_length = std::max(max_length, glm::length(grid.ProfileAt(v)));
+
+	// 64-bit throughout: a streamed mesh may outgrow size_t on a 32-bit build
+	uint64_t column_indices = layout.IndexCount(ParametricTopology::TriangleList) / rotation_segments;
+	uint64_t ring_vertex_count = uint64_t(layout.ring_rows) * rotation_segments;
+
+	ParametricMeshTile tile;
+	tile.total_vertex_count = ring_vertex_count + layout.pole_count;
+	tile.total_index_count = column_indices * rotation_segments;
+	tile.bounding_radius = float(max_scale * max_length);
+	tile.first_vertex = 0;
+	tile.first_index = 0;
+	tile.last = false;
+
+	uint64_t tile_columns = uint64_t(options.tile_vertex_count) / std::max(layout.ring_rows, 1);
+	tile_columns = std::max<uint64_t>(1, std::min<uint64_t>(tile_columns, rotation_segments));
+
+	// A single tile, bounded by tile_vertex_count, so it does fit in memory
+	std::vector<glm::vec3> positions(size_t(std::max<uint64_t>(tile_columns * layout.ring_rows, layout.pole_count)));
+	std::vector<glm::vec3> normals(positions.size());
+	std::vector<uint64_t> indices(size_t(tile_columns * column_indices));
+	ParametricPoleNormals<T> poles;
+
+	int column_begin = 0;
+	auto SurfacePoint = [&grid, &column_begin](int v, int r, Vec3& position, Vec3& tangent_r, Vec3& tangent_v)
+	{
+		ParametricRevolutionPoint(grid, grid.rotations[r - column_begin], v, position, tangent_r, tangent_v);
+	};
+
+	for (; column_begin < rotation_segments; column_begin = int(column_begin + tile_columns))
+	{
+		int column_end = int(std::min<uint64_t>(column_begin + tile_columns, rotation_segments));
+
+		grid.rotations.resize(column_end - column_begin);
+		for (int r = column_begin; r < column_end; ++r)
+			StoreParametricRotation(grid.rotations[r - column_begin], r / double(rotation_segments), squiggle);
 
-			auto to_next_v = parametric_surface(nv + epsilonv, nr) - parametric_surface(nv, nr);
-			auto from_prev_v = parametric_surface(nv, nr) - parametric_surface(nv - epsilonv, nr);
-			auto tangent_v = (to_next_v + from_prev_v) / 2.;
+		BuildParametricRingVertices<T>(positions.data(), normals.data(), layout, SurfacePoint, column_begin, column_end, poles, options);
+		BuildParametricListIndices(indices.data(), layout, column_begin, column_end, options);
 
-			auto to_next_r = parametric_surface(nv, nr + epsilonr) - parametric_surface(nv, nr);
-			auto from_prev_r = parametric_surface(nv, nr) - parametric_surface(nv, nr - epsilonr);
-			auto tangent_r = (to_next_r + from_prev_r) / 2.;
+		tile.positions = positions.data();
+		tile.normals = normals.data();
+		tile.vertex_count = uint64_t(column_end - column_begin) * layout.ring_rows;
+		tile.indices = indices.data();
+		tile.index_count = uint64_t(column_end - column_begin) * column_indices;
+		if (!sink(tile))
+			return false;
 
-			auto normal = glm::normalize(glm::cross(tangent_r, tangent_v));
-			normals.push_back(normal);
+		tile.first_vertex += tile.vertex_count;
+		tile.first_index += tile.index_count;
+	}
+
+	BuildParametricPoleVertices(positions.data(), normals.data(), layout, poles);
+
+	tile.vertex_count = layout.pole_count;
+	tile.index_count = 0;
+	tile.last = true;
+	return sink(tile);
+}
+
+template bool StreamParametricShapeOfRevolution<double>(ParametricSampleGrid&, bool, const ParametricMeshSink&, const ParametricShapeOptions&);
+template bool StreamParametricShapeOfRevolution<float>(FloatParametricSampleGrid&, bool, const ParametricMeshSink&, const ParametricShapeOptions&);
+
+/* Batch Evaluation */
+void EvaluateParametricLine(glm::dvec2(*parametric_line)(double), const double* t, glm::dvec2* out, size_t count)
+{
+	if (auto batch = FindParametricLineBatch<double>(parametric_line))
+		batch(t, out, count);
+	else
+		for (size_t i = 0; i < count; ++i)
+			out[i] = parametric_line(t[i]);
+}
+
+void EvaluateParametricLine(glm::dvec2(*parametric_line)(double), const float* t, glm::vec2* out, size_t count)
+{
+	if (auto batch = FindParametricLineBatch<float>(parametric_line))
+		batch(t, out, count);
+	else
+		for (size_t i = 0; i < count; ++i)
+			out[i] = glm::vec2(parametric_line(t[i]));
+}
+
+template <typename T>
+ParametricLineBatch<T> FindParametricLineBatch(glm::dvec2(*parametric_line)(double))
+{
+	if (parametric_line == ParametricHalfSquiggle)
+		return ParametricHalfSquiggleBatch;
+	if (parametric_line == ParametricHalfCircle)
+		return ParametricHalfCircleBatch;
+	if (parametric_line == ParametricCircle)
+		return ParametricCircleBatch;
+	if (parametric_line == ParametricSpikes)
+		return ParametricSpikesBatch;
+	return nullptr;
+}
+
+template ParametricLineBatch<double> FindParametricLineBatch<double>(glm::dvec2(*)(double));
+template ParametricLineBatch<float> FindParametricLineBatch<float>(glm::dvec2(*)(double));
+
+const char* FindParametricLineName(glm::dvec2(*parametric_line)(double))
+{
+	if (parametric_line == ParametricHalfSquiggle)
+		return "half_squiggle";
+	if (parametric_line == ParametricHalfCircle)
+		return "half_circle";
+	if (parametric_line == ParametricCircle)
+		return "circle";
+	if (parametric_line == ParametricSpikes)
+		return "spikes";
+	return nullptr;
+}
+
+/* Adaptive Sampling */
+// Largest distance of the quarter points from the chord
+static double ParametricChordError(const std::function<glm::dvec3(double)>& curve, double begin, double end)
+{
+	auto a = curve(begin);
+	auto ab = curve(end) - a;
+	double length2 = glm::dot(ab, ab);
+
+	double error = 0;
+	for (int i = 1; i < 4; ++i)
+	{
+		auto ap = curve(glm::mix(begin, end, i / 4.)) - a;
+		double along = length2 > 0 ? glm::clamp(glm::dot(ap, ab) / length2, 0., 1.) : 0.;
+		error = std::max(error, glm::length(ap - along * ab));
+	}
+	return error;
+}
+
+// The chord error of a short step h is about curvature * h^2 / 8, so the
+// square root of the error of each fine step is how many segments it is worth
+// at unit tolerance. Entry i sums the first i steps.
+static const int ParametricFineSteps = 4096;
+
+static std::vector<double> ParametricCurveDensity(const std::function<glm::dvec3(double)>& curve)
+{
+	std::vector<double> cumulative(ParametricFineSteps + 1, 0.);
+	for (int i = 0; i < ParametricFineSteps; ++i)
+	{
+		double error = ParametricChordError(curve, i / double(ParametricFineSteps), (i + 1) / double(ParametricFineSteps));
+		cumulative[i + 1] = cumulative[i] + std::sqrt(error);
+	}
+	return cumulative;
+}
+
+// Spreads the density evenly, which gives every segment about the same
+// error. The estimate is off near cusps, so segments still out of tolerance
+// are halved.
+static std::vector<double> SubdivideParametricCurve(
+	const std::function<glm::dvec3(double)>& curve,
+	const std::vector<double>& cumulative,
+	double tolerance,
+	int min_segments,
+	int max_segments,
+	bool closed
+)
+{
+	const int fine_steps = ParametricFineSteps;
+
+	// A straight curve has no density and a tolerance of zero or less no
+	// estimate, so both start from min_segments, and the refinement below
+	// splits whatever is out of tolerance. Clamped before the conversion,
+	// which is undefined past the range of int.
+	double estimate = cumulative.back() > 0 && tolerance > 0 ? cumulative.back() / std::sqrt(tolerance) : 0.;
+	int segment_count = int(glm::clamp(std::ceil(estimate), double(min_segments), double(max_segments)));
+
+	std::vector<double> parameters;
+	parameters.push_back(0.);
+	int step = 1;
+	for (int i = 1; i < segment_count; ++i)
+	{
+		double target = cumulative.back() * i / segment_count;
+		while (step < fine_steps && cumulative[step] < target)
+			++step;
+
+		// Even steps where the curve is straight
+		double below = cumulative[step - 1], above = cumulative[step];
+		double t = above > below ? (step - 1 + (target - below) / (above - below)) / fine_steps : i / double(segment_count);
+		parameters.push_back(std::max(t, parameters.back()));
+	}
+	parameters.push_back(1.);
+
+	std::vector<double> refined;
+	for (bool split = true; split && int(parameters.size()) <= max_segments; parameters.swap(refined))
+	{
+		split = false;
+		refined.clear();
+		for (size_t i = 0; i + 1 < parameters.size(); ++i)
+		{
+			refined.push_back(parameters[i]);
+			if (ParametricChordError(curve, parameters[i], parameters[i + 1]) > tolerance && int(refined.size() + parameters.size() - i) <= max_segments + 1)
+			{
+				refined.push_back((parameters[i] + parameters[i + 1]) / 2);
+				split = true;
+			}
 		}
+		refined.push_back(1.);
+	}
+
+	if (closed)
+		parameters.pop_back();
+	return parameters;
+}
+
+std::vector<double> SubdivideParametricCurve(
+	const std::function<glm::dvec3(double)>& curve,
+	double tolerance,
+	int min_segments,
+	int max_segments,
+	bool closed
+)
+{
+	return SubdivideParametricCurve(curve, ParametricCurveDensity(curve), tolerance, min_segments, max_segments, closed);
+}
+
+// The profile at the largest rotation scale, which bounds the chord error of
+// every ring row
+static std::function<glm::dvec3(double)> ProfileErrorCurve(const std::function<glm::dvec2(double)>& parametric_line, bool squiggle)
+{
+	double max_scale = 0;
+	for (int r = 0; r < 1024; ++r)
+		max_scale = std::max(max_scale, std::abs(EvaluateParametricRotation(r / 1024., squiggle).scale));
 
-	auto VRtoIndex = [vertical_segments, rotation_segments](int v, int r)
+	return [parametric_line, max_scale](double t) { return glm::dvec3(max_scale * parametric_line(t), 0); };
+}
+
+// The ring through the widest and highest profile point, which bounds the
+// chord error of every rotation column
+static std::function<glm::dvec3(double)> RotationErrorCurve(const std::function<glm::dvec2(double)>& parametric_line, bool squiggle)
+{
+	glm::dvec2 extent(0);
+	for (int i = 0; i <= ParametricFineSteps; ++i)
+		extent = glm::max(extent, glm::abs(parametric_line(i / double(ParametricFineSteps))));
+
+	return [extent, squiggle](double nr)
 	{
-		return (r % rotation_segments) * vertical_segments + v;
+		auto rotation = EvaluateParametricRotation(nr, squiggle);
+		return rotation.scale * glm::dvec3(extent.x * rotation.cos_angle, extent.y, -extent.x * rotation.sin_angle);
 	};
-	indices.reserve(rotation_segments * (vertical_segments - 1) * 6);
+}
+
+// Below this the shapes stop looking round
+static const int ParametricMinSegments = 8;
+
+void SubdivideParametricShapeOfRevolution(
+	const std::function<glm::dvec2(double)>& parametric_line,
+	double tolerance,
+	bool squiggle,
+	int max_segments,
+	std::vector<double>& profile_parameters,
+	std::vector<double>& rotation_parameters
+)
+{
+	auto profile_curve = ProfileErrorCurve(parametric_line, squiggle);
+	auto rotation_curve = RotationErrorCurve(parametric_line, squiggle);
+	auto profile_density = ParametricCurveDensity(profile_curve);
+	auto rotation_density = ParametricCurveDensity(rotation_curve);
+
+	// The two chord errors add up where a row and a column sag together. With
+	// densities a and b the segment count a / sqrt(e_a) + b / sqrt(e_b) for
+	// e_a + e_b = tolerance is least at e_a : e_b = a^2/3 : b^2/3.
+	double profile_weight = std::pow(profile_density.back(), 2. / 3);
+	double rotation_weight = std::pow(rotation_density.back(), 2. / 3);
+	double profile_share = profile_weight + rotation_weight > 0 ? profile_weight / (profile_weight + rotation_weight) : 0.5;
+
+	profile_parameters = SubdivideParametricCurve(
+		profile_curve, profile_density,
+		tolerance * profile_share, ParametricMinSegments, max_segments, false
+	);
+	rotation_parameters = SubdivideParametricCurve(
+		rotation_curve, rotation_density,
+		tolerance * (1 - profile_share), ParametricMinSegments, max_segments, true
+	);
+}
+
+double MeasureParametricShapeOfRevolution(
+	const std::function<glm::dvec2(double)>& parametric_line,
+	bool squiggle,
+	int vertical_segments,
+	int rotation_segments
+)
+{
+	std::vector<double> profile_parameters(vertical_segments);
+	for (int v = 0; v < vertical_segments; ++v)
+		profile_parameters[v] = v / double(vertical_segments - 1);
+
+	std::vector<double> rotation_parameters(rotation_segments);
 	for (int r = 0; r < rotation_segments; ++r)
-		for (int v = 0; v < vertical_segments - 1; ++v)
-		{
-			indices.push_back(VRtoIndex(v + 1, r));
-			indices.push_back(VRtoIndex(v, r + 1));
-			indices.push_back(VRtoIndex(v, r));
+		rotation_parameters[r] = r / double(rotation_segments);
 
-			indices.push_back(VRtoIndex(v + 1, r));
-			indices.push_back(VRtoIndex(v + 1, r + 1));
-			indices.push_back(VRtoIndex(v, r + 1));
-		}
+	return MeasureParametricShapeOfRevolution(parametric_line, squiggle, profile_parameters, rotation_parameters);
+}
+
+double MeasureParametricShapeOfRevolution(
+	const std::function<glm::dvec2(double)>& parametric_line,
+	bool squiggle,
+	const std::vector<double>& profile_parameters,
+	const std::vector<double>& rotation_parameters
+)
+{
+	auto profile_curve = ProfileErrorCurve(parametric_line, squiggle);
+	auto rotation_curve = RotationErrorCurve(parametric_line, squiggle);
+
+	double profile_error = 0;
+	for (size_t v = 0; v + 1 < profile_parameters.size(); ++v)
+		profile_error = std::max(profile_error, ParametricChordError(profile_curve, profile_parameters[v], profile_parameters[v + 1]));
+
+	double rotation_error = 0;
+	for (size_t r = 0; r < rotation_parameters.size(); ++r)
+	{
+		double end = r + 1 < rotation_parameters.size() ? rotation_parameters[r + 1] : 1.;
+		rotation_error = std::max(rotation_error, ParametricChordError(rotation_curve, rotation_parameters[r], end));
+	}
+
+	return profile_error + rotation_error;
+}
+
+/* Generator Functions */
+void GenerateParametricShapeFrom2D(
+	std::vector<glm::vec3>& positions,
+	std::vector<glm::vec3>& normals,
+	std::vector<GLuint>& indices,
+	glm::dvec2(*parametric_line)(double),
+	int vertical_segments,
+	int rotation_segments,
+	bool squiggle
+)
+{
+	ParametricSampleGrid grid;
+	GenerateParametricShapeFrom2D<glm::dvec2(*)(double)>(positions, normals, indices, parametric_line, vertical_segments, rotation_segments, squiggle, grid);
+}
+
+void GenerateParametricShapeFrom3D(
+	std::vector<glm::vec3>& positions,
+	std::vector<glm::vec3>& normals,
+	std::vector<GLuint>& indices,
+	glm::dvec3(*parametric_surface)(double, double),
+	int vertical_segments,
+	int rotation_segments
+)
+{
+	ParametricSampleGrid grid;
+	GenerateParametricShapeFrom3D<glm::dvec3(*)(double, double)>(positions, normals, indices, parametric_surface, vertical_segments, rotation_segments, grid);
 }
 
 /* Example 2D Parametric Functions */
@@ -164,4 +994,115 @@ glm::dvec2 ParametricSpikes(double t)
 	auto r = 0.3;
 	auto a = 2 + 4 * 2;
 	return (glm::dvec2(cos(t) + sin(a*t) / a, sin(t) + cos(a*t) / a)) * r + c;
-};
\ No newline at end of file
+};
+
+/* Batch 2D Parametric Functions */
+
+// Runs profile(t, x, y) over the widest lane type for T and finishes the tail
+// one lane at a time; glm::vec<2, T> is two packed scalars.
+template <typename T, typename Profile>
+static void EvaluateProfileBatch(const T* t, glm::vec<2, T, glm::defaultp>* out, size_t count, const Profile& profile)
+{
+	typedef typename SimdLanes<T>::Vector Vector;
+	typedef typename SimdLanes<T>::Single Single;
+
+	T* xy = &out[0].x;
+
+	size_t i = 0;
+	for (; i + Vector::width <= count; i += Vector::width)
+	{
+		Vector x, y;
+		profile(Vector::Load(t + i), x, y);
+		StoreInterleaved(xy + 2 * i, x, y);
+	}
+
+	for (; i < count; ++i)
+	{
+		Single x, y;
+		profile(Single::Load(t + i), x, y);
+		StoreInterleaved(xy + 2 * i, x, y);
+	}
+}
+
+// Profile kernels over any lane type, matching the scalar functions above
+static const auto HalfCircleProfile = [](auto t, auto& x, auto& y)
+{
+	using Lanes = decltype(t);
+	t = (t - Lanes::Broadcast(0.5)) * Lanes::Broadcast(glm::pi<double>());
+	SinCos(t, y, x);
+};
+
+static const auto HalfSquiggleProfile = [](auto t, auto& x, auto& y)
+{
+	using Lanes = decltype(t);
+	t = (t - Lanes::Broadcast(0.5)) * Lanes::Broadcast(glm::pi<double>());
+
+	Lanes sin6t, cos6t, cost;
+	SinCos(t * Lanes::Broadcast(6.), sin6t, cos6t);
+	SinCos(t, y, cost);
+	x = cos6t * Lanes::Broadcast(0.5) + Lanes::Broadcast(0.5);
+};
+
+static const auto CircleProfile = [](auto t, auto& x, auto& y)
+{
+	using Lanes = decltype(t);
+	t = (t - Lanes::Broadcast(0.5)) * Lanes::Broadcast(glm::two_pi<double>());
+
+	Lanes sint, cost;
+	SinCos(t, sint, cost);
+	x = cost * Lanes::Broadcast(0.3) + Lanes::Broadcast(0.7);
+	y = sint * Lanes::Broadcast(0.3);
+};
+
+static const auto SpikesProfile = [](auto t, auto& x, auto& y)
+{
+	using Lanes = decltype(t);
+	t = (t - Lanes::Broadcast(0.5)) * Lanes::Broadcast(glm::two_pi<double>());
+
+	auto a = 2 + 4 * 2;
+	Lanes sint, cost, sinat, cosat;
+	SinCos(t, sint, cost);
+	SinCos(t * Lanes::Broadcast(a), sinat, cosat);
+	x = (cost + sinat * Lanes::Broadcast(1. / a)) * Lanes::Broadcast(0.3) + Lanes::Broadcast(0.7);
+	y = (sint + cosat * Lanes::Broadcast(1. / a)) * Lanes::Broadcast(0.3);
+};
+
+void ParametricHalfSquiggleBatch(const double* t, glm::dvec2* out, size_t count)
+{
+	EvaluateProfileBatch(t, out, count, HalfSquiggleProfile);
+}
+
+void ParametricHalfCircleBatch(const double* t, glm::dvec2* out, size_t count)
+{
+	EvaluateProfileBatch(t, out, count, HalfCircleProfile);
+}
+
+void ParametricCircleBatch(const double* t, glm::dvec2* out, size_t count)
+{
+	EvaluateProfileBatch(t, out, count, CircleProfile);
+}
+
+void ParametricSpikesBatch(const double* t, glm::dvec2* out, size_t count)
+{
+	EvaluateProfileBatch(t, out, count, SpikesProfile);
+}
+
+void ParametricHalfSquiggleBatch(const float* t, glm::vec2* out, size_t count)
+{
+	EvaluateProfileBatch(t, out, count, HalfSquiggleProfile);
+}
+
+void ParametricHalfCircleBatch(const float* t, glm::vec2* out, size_t count)
+{
+	EvaluateProfileBatch(t, out, count, HalfCircleProfile);
+}
+
+void ParametricCircleBatch(const float* t, glm::vec2* out, size_t count)
+{
+	EvaluateProfileBatch(t, out, count, CircleProfile);
+}
+
+void ParametricSpikesBatch(const float* t, glm::vec2* out, size_t count)
+{
+	EvaluateProfileBatch(t, out, count, SpikesProfile);
+}
@@ -1,13 +1,501 @@
 #pragma once
 
+#include <cstdint>
 #include <iostream>
 #include <vector>
+#include <functional>
 #include "GLM/glm.hpp"
 #include "GLM/gtc/constants.hpp"
 #include "GLM/gtx/rotate_vector.hpp"
 #include "GLAD/glad.h"
 
+/* Mesh Layout */
+
+// TriangleList is two triangles (6 indices) per quad. TriangleStrip is one
+// strip per rotation column, 2 indices per row, with the columns separated by
+// ParametricPrimitiveRestartIndex; draw it with primitive restart enabled. The
+// strips split each quad along the other diagonal, with the same winding.
+enum class ParametricTopology
+{
+	TriangleList,
+	TriangleStrip,
+};
+
+const GLuint ParametricPrimitiveRestartIndex = 0xFFFFFFFF;
+
+// Where the vertices of each grid row go. A row whose whole ring sits on one
+// point of the axis (the ends of a closed profile) is a pole: it is welded into
+// a single vertex, stored after the ring vertices, and joined to its neighbour
+// rows by a triangle fan, so the zero-area triangles around it are dropped.
+// Triangle strips keep the pole twice per column to stay in step, leaving two
+// zero-area triangles per column for the rasterizer to reject.
+struct ParametricVertexLayout
+{
+	int vertical_segments = 0;
+	int rotation_segments = 0;
+
+	// Ring vertices are column-major, ring_rows per rotation column
+	int ring_rows = 0;
+	int pole_count = 0;
+	std::vector<char> pole_rows;
+	// Row within the column for ring rows, pole number for pole rows
+	std::vector<GLuint> row_indices;
+
+	// Every row a ring, then mark pole_rows and call Update
+	void Reset(int vertical_segments, int rotation_segments);
+	void Update();
+
+	uint64_t VertexCount() const;
+	uint64_t IndexCount(ParametricTopology topology = ParametricTopology::TriangleList) const;
+
+	GLuint VertexIndex(int v, int r) const
+	{
+		return GLuint(VertexIndex64(v, r));
+	}
+
+	// For streamed meshes, which can outgrow 32-bit indices
+	uint64_t VertexIndex64(int v, int r) const
+	{
+		if (pole_rows[v])
+			return uint64_t(ring_rows) * rotation_segments + row_indices[v];
+		return uint64_t(r % rotation_segments) * ring_rows + row_indices[v];
+	}
+};
+
+/* Squiggle */
+
+// Scales a surface of revolution by scale * (1 + amplitude * sin(frequency *
+// angle + phase)), angle being the rotation about Y in radians. A squiggle
+// asked of the generators is this default one, baked into the vertices; the
+// mesh vertex shader in main.cpp applies any other to an unsquiggled mesh
+// while drawing. The surface only closes for a whole frequency.
+struct ParametricSquiggle
+{
+	double frequency = 6;
+	double amplitude = 0.5;
+	double phase = 0;
+	double scale = 0.8;
+};
+
+/* Generator Scratch Buffers */
+
+// Per-rotation terms of a surface of revolution: the rotation about Y and the
+// squiggle scale applied to the profile, with its derivative in r.
+template <typename T>
+struct BasicParametricRotation
+{
+	T cos_angle;
+	T sin_angle;
+	T scale;
+	T scale_derivative;
+};
+
+// Surface samples on the (v, r) grid plus one halo row/column on every side,
+// so positions and central-difference normals read from the same evaluations.
+// Keep one around and pass it to the generators to reuse its allocation.
+//
+// The scalar type of the grid is the precision the generator works in: double
+// for export, float for large interactive meshes, where the built-in profiles
+// run at twice the SIMD width and scratch memory is halved.
+template <typename T>
+struct BasicParametricSampleGrid
+{
+	typedef glm::vec<2, T, glm::defaultp> Vec2;
+	typedef glm::vec<3, T, glm::defaultp> Vec3;
+
+	int vertical_segments = 0;
+	int rotation_segments = 0;
+	std::vector<Vec3> samples;
+
+	// Surfaces of revolution skip the full grid: the profile column (with the
+	// same halo, profile_parameters[v + 1] -> profile[v + 1]) is evaluated once
+	// and the rotation terms once per rotation segment.
+	std::vector<T> profile_parameters;
+	std::vector<Vec2> profile;
+	std::vector<BasicParametricRotation<T>> rotations;
+
+	// Set by SampleParametricShapeFrom2D / From3D; the builders need it
+	ParametricVertexLayout layout;
+
+	void Resize(int vertical_segments, int rotation_segments)
+	{
+		this->vertical_segments = vertical_segments;
+		this->rotation_segments = rotation_segments;
+		samples.resize(size_t(vertical_segments + 2) * (rotation_segments + 2));
+	}
+
+	// v in [-1, vertical_segments], r in [-1, rotation_segments]
+	Vec3& At(int v, int r)
+	{
+		return samples[size_t(r + 1) * (vertical_segments + 2) + (v + 1)];
+	}
+
+	const Vec3& At(int v, int r) const
+	{
+		return samples[size_t(r + 1) * (vertical_segments + 2) + (v + 1)];
+	}
+
+	// v in [-1, vertical_segments]
+	const Vec2& ProfileAt(int v) const
+	{
+		return profile[v + 1];
+	}
+
+	// Direction of the profile at row v, v in [0, vertical_segments). A
+	// central difference weighted by the parameter steps on either side, so
+	// adaptively spaced rows get the same tangent as uniform ones.
+	Vec2 ProfileTangentAt(int v) const
+	{
+		T before = profile_parameters[v + 1] - profile_parameters[v];
+		T after = profile_parameters[v + 2] - profile_parameters[v + 1];
+		return (ProfileAt(v + 1) - ProfileAt(v)) * (before / after) + (ProfileAt(v) - ProfileAt(v - 1)) * (after / before);
+	}
+};
+
+typedef BasicParametricSampleGrid<double> ParametricSampleGrid;
+typedef BasicParametricSampleGrid<float> FloatParametricSampleGrid;
+
+/* Generator Output */
+
+// Caller-owned destination for one mesh: layout.VertexCount() positions and
+// normals and layout.IndexCount() indices of the sampled grid. The builders
+// only ever write through these pointers, so they can point straight into a
+// mapped GL buffer. Indices start at 0 for the first vertex of this mesh.
+struct ParametricMeshOutput
+{
+	glm::vec3* positions;
+	glm::vec3* normals;
+	GLuint* indices;
+};
+
+// Grows the vectors by one mesh and returns the new tail as an output
+ParametricMeshOutput AppendParametricMeshOutput(
+	std::vector<glm::vec3>& positions,
+	std::vector<glm::vec3>& normals,
+	std::vector<GLuint>& indices,
+	const ParametricVertexLayout& layout,
+	ParametricTopology topology = ParametricTopology::TriangleList
+);
+
+/* Generator Options */
+struct ParametricShapeOptions
+{
+	// Threads used for sampling and mesh building, split by rotation column.
+	// 1 runs on the calling thread, 0 uses every hardware thread. The output
+	// is identical whatever the thread count.
+	unsigned thread_count = 1;
+
+	ParametricTopology topology = ParametricTopology::TriangleList;
+
+	// Streaming generators only: vertices per tile, rounded down to whole
+	// rotation columns (at least one). Bounds the memory they use.
+	size_t tile_vertex_count = 1 << 16;
+};
+
+/* Generator Helpers */
+
+// Splits [begin, end) into one contiguous chunk per thread and calls
+// body(chunk_begin, chunk_end) for each; the last chunk runs on the caller.
+void ParallelForRange(int begin, int end, unsigned thread_count, const std::function<void(int, int)>& body);
+
+template <typename ParametricSurface, typename T>
+void SampleParametricGrid(
+	BasicParametricSampleGrid<T>& grid,
+	const ParametricSurface& parametric_surface,
+	int vertical_segments,
+	int rotation_segments,
+	const ParametricShapeOptions& options = ParametricShapeOptions()
+);
+
+// Marks the rows whose grid samples all coincide as poles
+template <typename T>
+void FindParametricGridPoles(BasicParametricSampleGrid<T>& grid);
+
+template <typename T>
+void BuildParametricShapeFromGrid(
+	const ParametricMeshOutput& output,
+	const BasicParametricSampleGrid<T>& grid,
+	const ParametricShapeOptions& options = ParametricShapeOptions()
+);
+
+template <typename T>
+void BuildParametricShapeFromGrid(
+	std::vector<glm::vec3>& positions,
+	std::vector<glm::vec3>& normals,
+	std::vector<GLuint>& indices,
+	const BasicParametricSampleGrid<T>& grid,
+	const ParametricShapeOptions& options = ParametricShapeOptions()
+);
+
+/* Batch Evaluation */
+
+// out[i] = parametric_line(t[i]) for i in [0, count). The built-in profiles
+// have vectorized batch versions, in float and double, which the function
+// pointer overloads pick up automatically; any other callable is evaluated
+// one parameter at a time and converted to the output precision.
+template <typename ParametricLine, typename T>
+void EvaluateParametricLine(const ParametricLine& parametric_line, const T* t, glm::vec<2, T, glm::defaultp>* out, size_t count);
+
+void EvaluateParametricLine(glm::dvec2(*parametric_line)(double), const double* t, glm::dvec2* out, size_t count);
+void EvaluateParametricLine(glm::dvec2(*parametric_line)(double), const float* t, glm::vec2* out, size_t count);
+
+template <typename T>
+using ParametricLineBatch = void(*)(const T* t, glm::vec<2, T, glm::defaultp>* out, size_t count);
+
+// Batch version of a built-in profile, or nullptr for anything else
+template <typename T>
+ParametricLineBatch<T> FindParametricLineBatch(glm::dvec2(*parametric_line)(double));
+
+// Stable name of a built-in profile, or nullptr for anything else. Function
+// addresses change between builds, so this is what identifies a profile on
+// disk.
+const char* FindParametricLineName(glm::dvec2(*parametric_line)(double));
+
+template <typename ParametricLine, typename T>
+void SampleParametricProfile(
+	BasicParametricSampleGrid<T>& grid,
+	const ParametricLine& parametric_line,
+	int vertical_segments,
+	int rotation_segments
+);
+
+// One profile row per parameter, which must increase from 0 to 1
+template <typename ParametricLine, typename T>
+void SampleParametricProfile(
+	BasicParametricSampleGrid<T>& grid,
+	const ParametricLine& parametric_line,
+	const std::vector<double>& parameters
+);
+
+template <typename T>
+void SampleParametricRotations(BasicParametricSampleGrid<T>& grid, bool squiggle);
+
+// One rotation column per parameter, which must increase from 0 and stay
+// below 1
+template <typename T>
+void SampleParametricRotations(BasicParametricSampleGrid<T>& grid, bool squiggle, const std::vector<double>& parameters);
+
+// Marks the profile rows on the axis as poles, unless the rotation scale
+// spreads them along it
+template <typename T>
+void FindParametricRevolutionPoles(BasicParametricSampleGrid<T>& grid);
+
+// Radius of a bounding sphere around the origin, for the sampled profile and
+// rotation table of the grid
+template <typename T>
+T BoundParametricShapeOfRevolution(const BasicParametricSampleGrid<T>& grid);
+
+// Positions and analytic normals for the profile swept around Y, using only
+// the profile column and rotation table of the grid
+template <typename T>
+void BuildParametricShapeOfRevolution(
+	const ParametricMeshOutput& output,
+	const BasicParametricSampleGrid<T>& grid,
+	const ParametricShapeOptions& options = ParametricShapeOptions()
+);
+
+template <typename T>
+void BuildParametricShapeOfRevolution(
+	std::vector<glm::vec3>& positions,
+	std::vector<glm::vec3>& normals,
+	std::vector<GLuint>& indices,
+	const BasicParametricSampleGrid<T>& grid,
+	const ParametricShapeOptions& options = ParametricShapeOptions()
+);
+
+/* Adaptive Sampling */
+
+// Parameters in [0, 1] along a curve such that the chord between two
+// neighbours strays at most tolerance from the curve, probed at the quarter
+// points. Segments are spaced by the square root of the curvature, which
+// spends the fewest on a given tolerance, with between min_segments and
+// max_segments of them. A closed curve leaves out 1, where it is back at 0.
+std::vector<double> SubdivideParametricCurve(
+	const std::function<glm::dvec3(double)>& curve,
+	double tolerance,
+	int min_segments,
+	int max_segments,
+	bool closed
+);
+
+// Rows along the profile and columns around the axis for a surface of
+// revolution within tolerance (in model units) of the true surface. Each row
+// is checked at the largest rotation scale and each column at the widest and
+// highest point of the profile; the tolerance is shared between the two so
+// the total segment count is least.
+void SubdivideParametricShapeOfRevolution(
+	const std::function<glm::dvec2(double)>& parametric_line,
+	double tolerance,
+	bool squiggle,
+	int max_segments,
+	std::vector<double>& profile_parameters,
+	std::vector<double>& rotation_parameters
+);
+
+// The chord error, measured the same way, of the uniform sampling with these
+// segment counts: the tolerance at which the adaptive sampling looks as close
+// to the true surface
+double MeasureParametricShapeOfRevolution(
+	const std::function<glm::dvec2(double)>& parametric_line,
+	bool squiggle,
+	int vertical_segments,
+	int rotation_segments
+);
+
+// The same for any rows and columns, such as those from
+// SubdivideParametricShapeOfRevolution: rotation_parameters leaves out 1
+double MeasureParametricShapeOfRevolution(
+	const std::function<glm::dvec2(double)>& parametric_line,
+	bool squiggle,
+	const std::vector<double>& profile_parameters,
+	const std::vector<double>& rotation_parameters
+);
+
+/* Streaming Generation */
+
+// One piece of a streamed mesh. Tiles cover the rotation columns in order:
+// each holds the ring vertices of its columns and the triangles of the quads
+// from those columns to the next, which reach into the following tile (or
+// back to column 0). The last tile holds the poles and no indices. Indices
+// are into the whole mesh, so a sink places every tile by its offsets.
+struct ParametricMeshTile
+{
+	// The whole mesh, the same in every tile
+	uint64_t total_vertex_count;
+	uint64_t total_index_count;
+	float bounding_radius;
+
+	// Vertices [first_vertex, first_vertex + vertex_count) and indices
+	// [first_index, first_index + index_count) of the mesh
+	uint64_t first_vertex;
+	uint64_t first_index;
+	const glm::vec3* positions;
+	const glm::vec3* normals;
+	uint64_t vertex_count;
+	const uint64_t* indices;
+	uint64_t index_count;
+
+	bool last;
+};
+
+// Receives the tiles in order. The arrays are only valid during the call.
+// Returning false stops the generator.
+typedef std::function<bool(const ParametricMeshTile&)> ParametricMeshSink;
+
+// Streams the surface of revolution of a grid with a sampled profile (see
+// SampleParametricProfile) to sink as a triangle list, tile by tile. The
+// rotation table is evaluated a tile at a time into the grid, so memory use
+// depends on the profile rows and options.tile_vertex_count, never on the
+// number of rotation columns or the size of the mesh. False if the sink
+// stopped it.
+template <typename T>
+bool StreamParametricShapeOfRevolution(
+	BasicParametricSampleGrid<T>& grid,
+	bool squiggle,
+	const ParametricMeshSink& sink,
+	const ParametricShapeOptions& options = ParametricShapeOptions()
+);
+
 /* Generator Functions */
+
+// parametric_line / parametric_surface can be any callable: a free function,
+// a lambda (with or without captures) or a functor. Passing a callable type
+// lets the compiler inline it into the sampling loop; the function pointer
+// overloads below forward here and pay for an indirect call per sample.
+// The grid picks the precision; the overloads without one use double.
+// The generators append to their outputs. To write one mesh through a
+// ParametricMeshOutput instead, sample it into the grid first, size the output
+// from grid.layout and call BuildParametricShapeOfRevolution / FromGrid.
+template <typename ParametricLine, typename T>
+void SampleParametricShapeFrom2D(
+	BasicParametricSampleGrid<T>& grid,
+	const ParametricLine& parametric_line,
+	int vertical_segments,
+	int rotation_segments,
+	bool squiggle
+);
+
+// Like SampleParametricShapeFrom2D, with the segment counts replaced by a
+// tolerance: rows and columns are spent where the profile and the squiggle
+// bend, at most max_segments of each. The rows still share every column, so
+// the mesh is as watertight as a uniform one.
+template <typename ParametricLine, typename T>
+void SampleAdaptiveParametricShapeFrom2D(
+	BasicParametricSampleGrid<T>& grid,
+	const ParametricLine& parametric_line,
+	double tolerance,
+	bool squiggle,
+	int max_segments = 1024
+);
+
+template <typename ParametricLine, typename T>
+void GenerateParametricShapeFrom2D(
+	std::vector<glm::vec3>& positions,
+	std::vector<glm::vec3>& normals,
+	std::vector<GLuint>& indices,
+	const ParametricLine& parametric_line,
+	int vertical_segments,
+	int rotation_segments,
+	bool squiggle,
+	BasicParametricSampleGrid<T>& grid,
+	const ParametricShapeOptions& options = ParametricShapeOptions()
+);
+
+template <typename ParametricLine>
+void GenerateParametricShapeFrom2D(
+	std::vector<glm::vec3>& positions,
+	std::vector<glm::vec3>& normals,
+	std::vector<GLuint>& indices,
+	const ParametricLine& parametric_line,
+	int vertical_segments,
+	int rotation_segments,
+	bool squiggle
+);
+
+// The same mesh as GenerateParametricShapeFrom2D with a triangle list, in
+// tiles to sink instead of in memory
+template <typename ParametricLine, typename T>
+bool StreamParametricShapeFrom2D(
+	BasicParametricSampleGrid<T>& grid,
+	const ParametricLine& parametric_line,
+	int vertical_segments,
+	int rotation_segments,
+	bool squiggle,
+	const ParametricMeshSink& sink,
+	const ParametricShapeOptions& options = ParametricShapeOptions()
+);
+
+template <typename ParametricSurface, typename T>
+void SampleParametricShapeFrom3D(
+	BasicParametricSampleGrid<T>& grid,
+	const ParametricSurface& parametric_surface,
+	int vertical_segments,
+	int rotation_segments,
+	const ParametricShapeOptions& options = ParametricShapeOptions()
+);
+
+template <typename ParametricSurface, typename T>
+void GenerateParametricShapeFrom3D(
+	std::vector<glm::vec3>& positions,
+	std::vector<glm::vec3>& normals,
+	std::vector<GLuint>& indices,
+	const ParametricSurface& parametric_surface,
+	int vertical_segments,
+	int rotation_segments,
+	BasicParametricSampleGrid<T>& grid,
+	const ParametricShapeOptions& options = ParametricShapeOptions()
+);
+
+template <typename ParametricSurface>
+void GenerateParametricShapeFrom3D(
+	std::vector<glm::vec3>& positions,
+	std::vector<glm::vec3>& normals,
+	std::vector<GLuint>& indices,
+	const ParametricSurface& parametric_surface,
+	int vertical_segments,
+	int rotation_segments
+);
+
 void GenerateParametricShapeFrom2D(
 	std::vector<glm::vec3>& positions,
 	std::vector<glm::vec3>& normals,
@@ -31,4 +519,211 @@ void GenerateParametricShapeFrom3D(
 glm::dvec2 ParametricHalfSquiggle(double);
 glm::dvec2 ParametricHalfCircle(double);
 glm::dvec2 ParametricCircle(double);
-glm::dvec2 ParametricSpikes(double);
\ No newline at end of file
+glm::dvec2 ParametricSpikes(double);
+
+/* Batch 2D Parametric Functions */
+void ParametricHalfSquiggleBatch(const double* t, glm::dvec2* out, size_t count);
+void ParametricHalfCircleBatch(const double* t, glm::dvec2* out, size_t count);
+void ParametricCircleBatch(const double* t, glm::dvec2* out, size_t count);
+void ParametricSpikesBatch(const double* t, glm::dvec2* out, size_t count);
+
+void ParametricHalfSquiggleBatch(const float* t, glm::vec2* out, size_t count);
+void ParametricHalfCircleBatch(const float* t, glm::vec2* out, size_t count);
+void ParametricCircleBatch(const float* t, glm::vec2* out, size_t count);
+void ParametricSpikesBatch(const float* t, glm::vec2* out, size_t count);
+
+/* Generator Templates */
+template <typename ParametricLine, typename T>
+void EvaluateParametricLine(const ParametricLine& parametric_line, const T* t, glm::vec<2, T, glm::defaultp>* out, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+		out[i] = glm::vec<2, T, glm::defaultp>(parametric_line(t[i]));
+}
+
+template <typename ParametricLine, typename T>
+void SampleParametricProfile(
+	BasicParametricSampleGrid<T>& grid,
+	const ParametricLine& parametric_line,
+	int vertical_segments,
+	int rotation_segments
+)
+{
+	grid.vertical_segments = vertical_segments;
+	grid.rotation_segments = rotation_segments;
+	grid.profile_parameters.resize(vertical_segments + 2);
+	grid.profile.resize(vertical_segments + 2);
+
+	for (int v = -1; v <= vertical_segments; ++v)
+		grid.profile_parameters[v + 1] = T(v / double(vertical_segments - 1));
+	EvaluateParametricLine(parametric_line, grid.profile_parameters.data(), grid.profile.data(), grid.profile.size());
+}
+
+// The halo rows mirror the first and last steps
+template <typename ParametricLine, typename T>
+void SampleParametricProfile(
+	BasicParametricSampleGrid<T>& grid,
+	const ParametricLine& parametric_line,
+	const std::vector<double>& parameters
+)
+{
+	int vertical_segments = int(parameters.size());
+	grid.vertical_segments = vertical_segments;
+	grid.profile_parameters.resize(vertical_segments + 2);
+	grid.profile.resize(vertical_segments + 2);
+
+	grid.profile_parameters.front() = T(2 * parameters.front() - parameters[1]);
+	for (int v = 0; v < vertical_segments; ++v)
+		grid.profile_parameters[v + 1] = T(parameters[v]);
+	grid.profile_parameters.back() = T(2 * parameters.back() - parameters[vertical_segments - 2]);
+	EvaluateParametricLine(parametric_line, grid.profile_parameters.data(), grid.profile.data(), grid.profile.size());
+}
+
+template <typename ParametricSurface, typename T>
+void SampleParametricGrid(
+	BasicParametricSampleGrid<T>& grid,
+	const ParametricSurface& parametric_surface,
+	int vertical_segments,
+	int rotation_segments,
+	const ParametricShapeOptions& options
+)
+{
+	typedef typename BasicParametricSampleGrid<T>::Vec3 Vec3;
+
+	grid.Resize(vertical_segments, rotation_segments);
+
+	ParallelForRange(-1, rotation_segments + 1, options.thread_count, [&](int r_begin, int r_end)
+	{
+		for (int r = r_begin; r < r_end; ++r)
+			for (int v = -1; v <= vertical_segments; ++v)
+				grid.At(v, r) = Vec3(parametric_surface(T(v / double(vertical_segments - 1)), T(r / double(rotation_segments))));
+	});
+}
+
+template <typename ParametricLine, typename T>
+void SampleParametricShapeFrom2D(
+	BasicParametricSampleGrid<T>& grid,
+	const ParametricLine& parametric_line,
+	int vertical_segments,
+	int rotation_segments,
+	bool squiggle
+)
+{
+	// The profile only depends on v and the rotation only on r, so each is
+	// evaluated once and the mesh is assembled from the two tables.
+	SampleParametricProfile(grid, parametric_line, vertical_segments, rotation_segments);
+	SampleParametricRotations(grid, squiggle);
+	FindParametricRevolutionPoles(grid);
+}
+
+template <typename ParametricLine, typename T>
+void SampleAdaptiveParametricShapeFrom2D(
+	BasicParametricSampleGrid<T>& grid,
+	const ParametricLine& parametric_line,
+	double tolerance,
+	bool squiggle,
+	int max_segments
+)
+{
+	std::vector<double> profile_parameters, rotation_parameters;
+	SubdivideParametricShapeOfRevolution(
+		[&parametric_line](double t) { return glm::dvec2(parametric_line(t)); },
+		tolerance, squiggle, max_segments,
+		profile_parameters, rotation_parameters
+	);
+
+	SampleParametricProfile(grid, parametric_line, profile_parameters);
+	SampleParametricRotations(grid, squiggle, rotation_parameters);
+	FindParametricRevolutionPoles(grid);
+}
+
+template <typename ParametricLine, typename T>
+void GenerateParametricShapeFrom2D(
+	std::vector<glm::vec3>& positions,
+	std::vector<glm::vec3>& normals,
+	std::vector<GLuint>& indices,
+	const ParametricLine& parametric_line,
+	int vertical_segments,
+	int rotation_segments,
+	bool squiggle,
+	BasicParametricSampleGrid<T>& grid,
+	const ParametricShapeOptions& options
+)
+{
+	SampleParametricShapeFrom2D(grid, parametric_line, vertical_segments, rotation_segments, squiggle);
+	auto output = AppendParametricMeshOutput(positions, normals, indices, grid.layout, options.topology);
+	BuildParametricShapeOfRevolution(output, grid, options);
+}
+
+template <typename ParametricLine>
+void GenerateParametricShapeFrom2D(
+	std::vector<glm::vec3>& positions,
+	std::vector<glm::vec3>& normals,
+	std::vector<GLuint>& indices,
+	const ParametricLine& parametric_line,
+	int vertical_segments,
+	int rotation_segments,
+	bool squiggle
+)
+{
+	ParametricSampleGrid grid;
+	GenerateParametricShapeFrom2D(positions, normals, indices, parametric_line, vertical_segments, rotation_segments, squiggle, grid);
+}
+
+template <typename ParametricLine, typename T>
+bool StreamParametricShapeFrom2D(
+	BasicParametricSampleGrid<T>& grid,
+	const ParametricLine& parametric_line,
+	int vertical_segments,
+	int rotation_segments,
+	bool squiggle,
+	const ParametricMeshSink& sink,
+	const ParametricShapeOptions& options
+)
+{
+	SampleParametricProfile(grid, parametric_line, vertical_segments, rotation_segments);
+	return StreamParametricShapeOfRevolution(grid, squiggle, sink, options);
+}
+
+template <typename ParametricSurface, typename T>
+void SampleParametricShapeFrom3D(
+	BasicParametricSampleGrid<T>& grid,
+	const ParametricSurface& parametric_surface,
+	int vertical_segments,
+	int rotation_segments,
+	const ParametricShapeOptions& options
+)
+{
+	SampleParametricGrid(grid, parametric_surface, vertical_segments, rotation_segments, options);
+	FindParametricGridPoles(grid);
+}
+
+template <typename ParametricSurface, typename T>
+void GenerateParametricShapeFrom3D(
+	std::vector<glm::vec3>& positions,
+	std::vector<glm::vec3>& normals,
+	std::vector<GLuint>& indices,
+	const ParametricSurface& parametric_surface,
+	int vertical_segments,
+	int rotation_segments,
+	BasicParametricSampleGrid<T>& grid,
+	const ParametricShapeOptions& options
+)
+{
+	SampleParametricShapeFrom3D(grid, parametric_surface, vertical_segments, rotation_segments, options);
+	auto output = AppendParametricMeshOutput(positions, normals, indices, grid.layout, options.topology);
+	BuildParametricShapeFromGrid(output, grid, options);
+}
+
+template <typename ParametricSurface>
+void GenerateParametricShapeFrom3D(
+	std::vector<glm::vec3>& positions,
+	std::vector<glm::vec3>& normals,
+	std::vector<GLuint>& indices,
+	const ParametricSurface& parametric_surface,
+	int vertical_segments,
+	int rotation_segments
+)
+{
+	ParametricSampleGrid grid;
+	GenerateParametricShapeFrom3D(positions, normals, indices, parametric_surface, vertical_segments, rotation_segments, grid);
+}
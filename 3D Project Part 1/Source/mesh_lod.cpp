@@ -0,0 +1,72 @@
+#include "mesh_lod.h"
+
+#include <algorithm>
+#include <limits>
+#include "GLM/gtc/constants.hpp"
+
+/* Mesh Levels of Detail */
+
+void MeshLOD::AddLevel(const SharedVAO& vao, int segments, GLsizei triangle_count)
+{
+	// The finest level has nothing finer to hand over to
+	float radius = levels.empty()
+		? std::numeric_limits<float>::infinity()
+		: segments * MeshLODEdgePixels / glm::two_pi<float>();
+
+	levels.push_back(vao);
+	max_screen_radius.push_back(radius);
+	triangle_counts.push_back(triangle_count);
+}
+
+// The rows of the transform give how far a unit step in model space moves the
+// clip x and y; the longest such step bounds the projected sphere. The
+// perspective divide uses w at the center, which is exact for the affine
+// transforms the scenes use.
+float ProjectMeshLODRadius(const MeshLOD& lod, const glm::mat4& transform, glm::ivec2 screen_dimensions)
+{
+	glm::vec4 center = transform * glm::vec4(lod.bounding_center, 1);
+	glm::vec3 row_x(transform[0][0], transform[1][0], transform[2][0]);
+	glm::vec3 row_y(transform[0][1], transform[1][1], transform[2][1]);
+
+	float w = std::abs(center.w) > std::numeric_limits<float>::epsilon() ? std::abs(center.w) : 1.f;
+	float radius_x = glm::length(row_x) * lod.bounding_radius / w * screen_dimensions.x / 2;
+	float radius_y = glm::length(row_y) * lod.bounding_radius / w * screen_dimensions.y / 2;
+
+	return std::max(radius_x, radius_y);
+}
+
+// Refining happens as soon as the current level is too coarse; coarsening
+// waits for the hysteresis margin
+int SelectMeshLOD(const MeshLOD& lod, float screen_radius, int level)
+{
+	int level_count = int(lod.levels.size());
+
+	// A new draw goes straight to the coarsest level that is fine enough
+	if (level < 0)
+	{
+		level = level_count - 1;
+		while (level > 0 && screen_radius > lod.max_screen_radius[level])
+			--level;
+		return level;
+	}
+
+	level = std::min(level, level_count - 1);
+
+	while (level > 0 && screen_radius > lod.max_screen_radius[level])
+		--level;
+	while (level + 1 < level_count && screen_radius <= lod.max_screen_radius[level + 1] * (1 - MeshLODHysteresis))
+		++level;
+
+	return level;
+}
+
+GLsizei DrawMeshLOD(const MeshLOD& lod, const Program& program, const glm::mat4& transform, glm::ivec2 screen_dimensions, int& level)
+{
+	level = SelectMeshLOD(lod, ProjectMeshLODRadius(lod, transform, screen_dimensions), level);
+
+	const VAO& vao = *lod.levels[level];
+	BindVAO(vao, program);
+	DrawVAO(vao);
+
+	return lod.triangle_counts[level];
+}
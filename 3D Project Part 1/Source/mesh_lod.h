@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vector>
+#include "GLM/glm.hpp"
+#include "GLAD/glad.h"
+#include "opengl_utilities.h"
+
+/* Mesh Levels of Detail */
+
+// A level is used while its edges stay about MeshLODEdgePixels long on screen:
+// a level with n segments around the bounding sphere is good up to a projected
+// radius of n * MeshLODEdgePixels / 2 PI pixels.
+const float MeshLODEdgePixels = 8.f;
+
+// A draw only moves to a coarser level once its projected radius is this
+// fraction below the switch point, so objects resting near it don't flicker
+// between levels every frame.
+const float MeshLODHysteresis = 0.15f;
+
+// The same shape at decreasing segment counts, finest first, inside one
+// bounding sphere in model space.
+struct MeshLOD
+{
+	glm::vec3 bounding_center = glm::vec3(0);
+	float bounding_radius = 0;
+
+	std::vector<SharedVAO> levels;
+	// Largest projected radius, in pixels, each level is good for
+	std::vector<float> max_screen_radius;
+	std::vector<GLsizei> triangle_counts;
+
+	// Levels have to be added finest first. segments is the smaller of the
+	// vertical and rotation segment counts of the level.
+	void AddLevel(const SharedVAO& vao, int segments, GLsizei triangle_count);
+};
+
+// Radius in pixels of the bounding sphere after transform (model to clip
+// space), for a viewport of screen_dimensions
+float ProjectMeshLODRadius(const MeshLOD& lod, const glm::mat4& transform, glm::ivec2 screen_dimensions);
+
+// Picks the level for a projected radius, starting from the level the same
+// draw used last frame, or -1 for a draw that has no level yet
+int SelectMeshLOD(const MeshLOD& lod, float screen_radius, int level);
+
+// Selects the level of a draw, updating level, then binds and draws it like
+// BindVAO and DrawVAO. Returns the number of triangles submitted.
+GLsizei DrawMeshLOD(const MeshLOD& lod, const Program& program, const glm::mat4& transform, glm::ivec2 screen_dimensions, int& level);
@@ -0,0 +1,209 @@
+#include "mesh_optimization.h"
+
+#include <algorithm>
+#include <cmath>
+
+/* Vertex Cache Optimization */
+
+// Forsyth's scoring: vertices used by the last triangle score a flat 0.75 (so
+// the next triangle doesn't have to share all of them), older cache entries
+// fall off with their age, and vertices with few triangles left get a boost
+// so they are finished off instead of leaving lone triangles behind.
+static float VertexScore(int cache_position, unsigned remaining_triangles)
+{
+	if (remaining_triangles == 0)
+		return -1.f;
+
+	float score = 0.f;
+	if (cache_position >= 0)
+	{
+		if (cache_position < 3)
+			score = 0.75f;
+		else
+			score = std::pow(1.f - float(cache_position - 3) / (MeshVertexCacheSize - 3), 1.5f);
+	}
+
+	return score + 2.f / std::sqrt(float(remaining_triangles));
+}
+
+void OptimizeVertexCache(
+	GLuint* destination,
+	const GLuint* indices,
+	size_t index_count,
+	size_t vertex_count
+)
+{
+	size_t triangle_count = index_count / 3;
+
+	std::vector<GLuint> source;
+	if (destination == indices)
+	{
+		source.assign(indices, indices + index_count);
+		indices = source.data();
+	}
+
+	// Triangles of each vertex; the first remaining_triangles[v] entries of
+	// its range are the ones not emitted yet
+	std::vector<size_t> vertex_offsets(vertex_count + 1, 0);
+	for (size_t i = 0; i < index_count; ++i)
+		++vertex_offsets[indices[i] + 1];
+	for (size_t v = 0; v < vertex_count; ++v)
+		vertex_offsets[v + 1] += vertex_offsets[v];
+
+	std::vector<unsigned> remaining_triangles(vertex_count, 0);
+	std::vector<size_t> vertex_triangles(index_count);
+	for (size_t i = 0; i < index_count; ++i)
+	{
+		GLuint v = indices[i];
+		vertex_triangles[vertex_offsets[v] + remaining_triangles[v]++] = i / 3;
+	}
+
+	std::vector<int> cache_positions(vertex_count, -1);
+	std::vector<float> vertex_scores(vertex_count);
+	for (size_t v = 0; v < vertex_count; ++v)
+		vertex_scores[v] = VertexScore(-1, remaining_triangles[v]);
+
+	std::vector<float> triangle_scores(triangle_count);
+	std::vector<bool> emitted(triangle_count, false);
+	for (size_t t = 0; t < triangle_count; ++t)
+		triangle_scores[t] = vertex_scores[indices[t * 3]] + vertex_scores[indices[t * 3 + 1]] + vertex_scores[indices[t * 3 + 2]];
+
+	// The cache holds 3 extra entries while a triangle is being added, so the
+	// vertices it pushes out still get their scores lowered
+	std::vector<GLuint> cache, next_cache;
+	cache.reserve(MeshVertexCacheSize + 3);
+	next_cache.reserve(MeshVertexCacheSize + 3);
+
+	auto best_triangle = std::max_element(triangle_scores.begin(), triangle_scores.end()) - triangle_scores.begin();
+	size_t scan_cursor = 0;
+
+	for (size_t output_triangle = 0; output_triangle < triangle_count; ++output_triangle)
+	{
+		// Nothing in the cache has triangles left, start again from the
+		// first triangle that hasn't been emitted
+		if (best_triangle < 0)
+		{
+			while (emitted[scan_cursor])
+				++scan_cursor;
+			best_triangle = scan_cursor;
+		}
+
+		const GLuint* triangle = indices + best_triangle * 3;
+		std::copy(triangle, triangle + 3, destination + output_triangle * 3);
+		emitted[best_triangle] = true;
+
+		next_cache.assign(triangle, triangle + 3);
+		for (GLuint v : cache)
+			if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+				next_cache.push_back(v);
+		if (next_cache.size() > MeshVertexCacheSize + 3)
+			next_cache.resize(MeshVertexCacheSize + 3);
+
+		for (int k = 0; k < 3; ++k)
+		{
+			GLuint v = triangle[k];
+			auto begin = vertex_triangles.begin() + vertex_offsets[v];
+			auto end = begin + remaining_triangles[v];
+			std::iter_swap(std::find(begin, end, size_t(best_triangle)), end - 1);
+			--remaining_triangles[v];
+		}
+
+		// Rescore the cache and every triangle it touches, picking the best
+		// of those as the next triangle
+		for (size_t position = 0; position < next_cache.size(); ++position)
+		{
+			GLuint v = next_cache[position];
+			cache_positions[v] = position < MeshVertexCacheSize ? int(position) : -1;
+			vertex_scores[v] = VertexScore(cache_positions[v], remaining_triangles[v]);
+		}
+
+		best_triangle = -1;
+		float best_score = -1.f;
+		for (GLuint v : next_cache)
+		{
+			for (size_t i = 0; i < remaining_triangles[v]; ++i)
+			{
+				size_t t = vertex_triangles[vertex_offsets[v] + i];
+				const GLuint* neighbour = indices + t * 3;
+				triangle_scores[t] = vertex_scores[neighbour[0]] + vertex_scores[neighbour[1]] + vertex_scores[neighbour[2]];
+
+				if (triangle_scores[t] > best_score)
+				{
+					best_score = triangle_scores[t];
+					best_triangle = t;
+				}
+			}
+		}
+
+		if (next_cache.size() > MeshVertexCacheSize)
+			next_cache.resize(MeshVertexCacheSize);
+		std::swap(cache, next_cache);
+	}
+}
+
+/* Vertex Fetch Optimization */
+void OptimizeVertexFetch(
+	glm::vec3* destination_positions,
+	glm::vec3* destination_normals,
+	GLuint* destination_indices,
+	const glm::vec3* positions,
+	const glm::vec3* normals,
+	const GLuint* indices,
+	size_t index_count,
+	size_t vertex_count
+)
+{
+	const GLuint unassigned = ~GLuint(0);
+	std::vector<GLuint> remap(vertex_count, unassigned);
+
+	GLuint next_vertex = 0;
+	for (size_t i = 0; i < index_count; ++i)
+	{
+		GLuint& remapped = remap[indices[i]];
+		if (remapped == unassigned)
+			remapped = next_vertex++;
+		destination_indices[i] = remapped;
+	}
+
+	for (size_t v = 0; v < vertex_count; ++v)
+	{
+		if (remap[v] == unassigned)
+			remap[v] = next_vertex++;
+		destination_positions[remap[v]] = positions[v];
+		destination_normals[remap[v]] = normals[v];
+	}
+}
+
+/* Statistics */
+VertexCacheStatistics AnalyzeVertexCache(
+	const GLuint* indices,
+	size_t index_count,
+	size_t vertex_count,
+	unsigned cache_size
+)
+{
+	// A vertex is still cached if fewer than cache_size misses happened since
+	// it was last loaded
+	std::vector<size_t> loaded_at(vertex_count, 0);
+	std::vector<bool> referenced(vertex_count, false);
+	size_t misses = 0;
+	size_t referenced_count = 0;
+
+	for (size_t i = 0; i < index_count; ++i)
+	{
+		GLuint v = indices[i];
+		if (!referenced[v])
+		{
+			referenced[v] = true;
+			++referenced_count;
+		}
+
+		if (loaded_at[v] == 0 || misses - loaded_at[v] + 1 > cache_size)
+			loaded_at[v] = ++misses;
+	}
+
+	VertexCacheStatistics statistics;
+	statistics.acmr = index_count ? double(misses) / (index_count / 3) : 0.;
+	statistics.atvr = referenced_count ? double(misses) / referenced_count : 0.;
+	return statistics;
+}
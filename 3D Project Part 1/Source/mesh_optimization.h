@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vector>
+#include "GLM/glm.hpp"
+#include "GLAD/glad.h"
+
+/* Mesh Optimization */
+
+// Optional stage between generation and upload for indexed triangle lists.
+// Run OptimizeVertexCache first, then OptimizeVertexFetch: the second keeps
+// the triangle order and only renumbers vertices. Neither reads from its
+// destination, so it can point into a mapped buffer.
+
+// Post-transform vertex cache model: FIFO of cache_size vertices
+const unsigned MeshVertexCacheSize = 32;
+
+struct VertexCacheStatistics
+{
+	// Vertices shaded per triangle, ~0.5 at best for a regular grid
+	double acmr;
+	// Vertices shaded per referenced vertex, 1 at best
+	double atvr;
+};
+
+// Reorders triangles for post-transform cache reuse (Forsyth's linear-speed
+// vertex cache optimization). destination may be indices.
+void OptimizeVertexCache(
+	GLuint* destination,
+	const GLuint* indices,
+	size_t index_count,
+	size_t vertex_count
+);
+
+// Renumbers vertices in the order the triangles first use them, so vertex
+// fetch walks the buffers forward. Unreferenced vertices go last, so all
+// vertex_count destination vertices are written. The destinations must not
+// overlap the sources.
+void OptimizeVertexFetch(
+	glm::vec3* destination_positions,
+	glm::vec3* destination_normals,
+	GLuint* destination_indices,
+	const glm::vec3* positions,
+	const glm::vec3* normals,
+	const GLuint* indices,
+	size_t index_count,
+	size_t vertex_count
+);
+
+VertexCacheStatistics AnalyzeVertexCache(
+	const GLuint* indices,
+	size_t index_count,
+	size_t vertex_count,
+	unsigned cache_size = MeshVertexCacheSize
+);
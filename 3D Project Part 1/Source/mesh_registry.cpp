@@ -0,0 +1,183 @@
+#include "mesh_registry.h"
+
+#include <algorithm>
+#include <cstring>
+
+/* Mesh Registry */
+
+// The format changes what gets uploaded, so it is part of both keys
+static std::string MeshRegistryKey(const MeshCacheKey& key, VertexFormat vertex_format)
+{
+	return key.Name() + (vertex_format == VertexFormat::Compressed ? "_compressed" : "_float");
+}
+
+// 64-bit FNV-1a over the counts, the format and every byte of the arrays
+static uint64_t HashMeshContents(
+	VertexFormat vertex_format,
+	const glm::vec3* positions,
+	const glm::vec3* normals,
+	size_t vertex_count,
+	const GLuint* indices,
+	size_t index_count
+)
+{
+	uint64_t hash = 14695981039346656037ull;
+	auto Hash = [&hash](const void* data, size_t size)
+	{
+		auto bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; ++i)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+	};
+
+	uint64_t header[] = { uint64_t(vertex_format), vertex_count, index_count };
+	Hash(header, sizeof(header));
+	Hash(positions, vertex_count * sizeof(glm::vec3));
+	Hash(normals, vertex_count * sizeof(glm::vec3));
+	Hash(indices, index_count * sizeof(GLuint));
+	return hash;
+}
+
+template <typename T>
+static bool SameArray(const std::vector<T>& registered, const T* data, size_t count)
+{
+	return registered.size() == count && (count == 0 || std::memcmp(registered.data(), data, count * sizeof(T)) == 0);
+}
+
+bool MeshRegistry::SameContents(
+	const Contents& contents,
+	const glm::vec3* positions,
+	const glm::vec3* normals,
+	size_t vertex_count,
+	const GLuint* indices,
+	size_t index_count
+)
+{
+	return SameArray(contents.positions, positions, vertex_count)
+		&& SameArray(contents.normals, normals, vertex_count)
+		&& SameArray(contents.indices, indices, index_count);
+}
+
+SharedVAO MeshRegistry::Find(const MeshCacheKey& key, VertexFormat vertex_format, float& bounding_radius)
+{
+	// Keys that can't be named are never registered
+	if (key.Name().empty())
+		return nullptr;
+
+	auto entry = by_key.find(MeshRegistryKey(key, vertex_format));
+	if (entry == by_key.end())
+		return nullptr;
+
+	SharedVAO vao = entry->second.vao.lock();
+	if (!vao)
+	{
+		by_key.erase(entry);
+		return nullptr;
+	}
+
+	bounding_radius = entry->second.bounding_radius;
+	statistics.requests++;
+	statistics.key_hits++;
+	statistics.bytes_saved += VAOBufferSize(*vao);
+	return vao;
+}
+
+SharedVAO MeshRegistry::Add(
+	const MeshCacheKey& key,
+	VertexFormat vertex_format,
+	const glm::vec3* positions,
+	const glm::vec3* normals,
+	size_t vertex_count,
+	const GLuint* indices,
+	size_t index_count,
+	float bounding_radius,
+	GeometryArena* arena
+)
+{
+	statistics.requests++;
+
+	uint64_t content_hash = HashMeshContents(vertex_format, positions, normals, vertex_count, indices, index_count);
+	auto content_entry = by_content.find(content_hash);
+
+	// The hash alone could pair two different meshes, so a hit is only shared
+	// when every byte agrees
+	SharedVAO vao;
+	if (content_entry != by_content.end())
+	{
+		const Entry& shared = content_entry->second;
+		vao = shared.vao.lock();
+		if (vao && !(shared.bounding_radius == bounding_radius
+			&& SameContents(*shared.contents, positions, normals, vertex_count, indices, index_count)))
+		{
+			statistics.hash_collisions++;
+			vao = nullptr;
+		}
+	}
+
+	Entry entry;
+	if (vao)
+	{
+		entry = content_entry->second;
+		statistics.content_hits++;
+		statistics.bytes_saved += VAOBufferSize(*vao);
+	}
+	else
+	{
+		auto fill = [&](glm::vec3* vao_positions, glm::vec3* vao_normals, GLuint* vao_indices)
+		{
+			std::copy(positions, positions + vertex_count, vao_positions);
+			std::copy(normals, normals + vertex_count, vao_normals);
+			std::copy(indices, indices + index_count, vao_indices);
+		};
+
+		vao = SharedVAO(
+			arena
+				? new VAO(*arena, GLsizei(vertex_count), GLsizei(index_count), fill)
+				: new VAO(GLsizei(vertex_count), GLsizei(index_count), fill, vertex_format),
+			[](VAO* vao)
+			{
+				DeleteVAO(*vao);
+				delete vao;
+			}
+		);
+		statistics.uploads++;
+
+		auto contents = std::make_shared<Contents>();
+		contents->positions.assign(positions, positions + vertex_count);
+		contents->normals.assign(normals, normals + vertex_count);
+		contents->indices.assign(indices, indices + index_count);
+
+		entry.vao = vao;
+		entry.bounding_radius = bounding_radius;
+		entry.contents = contents;
+
+		// A colliding live mesh keeps its place; this one is only found by key
+		Prune();
+		by_content.emplace(content_hash, entry);
+	}
+
+	if (!key.Name().empty())
+		by_key[MeshRegistryKey(key, vertex_format)] = entry;
+
+	return vao;
+}
+
+template <typename Entries>
+static void EraseExpired(Entries& entries)
+{
+	for (auto entry = entries.begin(); entry != entries.end();)
+	{
+		if (entry->second.vao.expired())
+			entry = entries.erase(entry);
+		else
+			++entry;
+	}
+}
+
+void MeshRegistry::Prune()
+{
+	EraseExpired(by_key);
+	EraseExpired(by_content);
+}
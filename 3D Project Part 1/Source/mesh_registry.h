@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "GLM/glm.hpp"
+#include "GLAD/glad.h"
+#include "opengl_utilities.h"
+#include "mesh_cache.h"
+
+/* Mesh Registry */
+
+struct MeshRegistryStatistics
+{
+	// Find and Add calls that returned a VAO
+	size_t requests = 0;
+	// VAOs created, each one generation or cache load and one upload
+	size_t uploads = 0;
+	// Requests for a key already registered, skipping generation and upload
+	size_t key_hits = 0;
+	// Meshes added under a new key with the contents of a registered one,
+	// skipping the upload
+	size_t content_hits = 0;
+	// Meshes whose contents hashed the same as a live one's but differed
+	size_t hash_collisions = 0;
+	// GPU memory that a VAO per request would have taken on top
+	GLsizeiptr bytes_saved = 0;
+};
+
+// Hands out one VAO per distinct mesh. Meshes are looked up by the key they
+// were generated from, so an identical request skips generation; a mesh added
+// under a new key is still shared when its contents are byte for byte those
+// of a live one. To compare them the registry keeps a host copy of every
+// distinct live mesh, found by a hash of its contents. It only keeps weak
+// references to the VAOs: meshes nothing draws any more are released, their
+// entries and copies dropped, and made again on the next request.
+struct MeshRegistry
+{
+	// The VAO registered for key in vertex_format, or null when the mesh has
+	// to be generated and added. bounding_radius is set on a hit.
+	SharedVAO Find(const MeshCacheKey& key, VertexFormat vertex_format, float& bounding_radius);
+
+	// Registers a generated mesh under key and returns its VAO, uploading it
+	// unless the same contents are registered already. The upload goes into
+	// arena when one is given, which has to be in vertex_format and outlive
+	// the VAO.
+	SharedVAO Add(
+		const MeshCacheKey& key,
+		VertexFormat vertex_format,
+		const glm::vec3* positions,
+		const glm::vec3* normals,
+		size_t vertex_count,
+		const GLuint* indices,
+		size_t index_count,
+		float bounding_radius,
+		GeometryArena* arena = nullptr
+	);
+
+	const MeshRegistryStatistics& Statistics() const
+	{
+		return statistics;
+	}
+
+private:
+	struct Contents
+	{
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec3> normals;
+		std::vector<GLuint> indices;
+	};
+
+	struct Entry
+	{
+		std::weak_ptr<VAO> vao;
+		float bounding_radius;
+		std::shared_ptr<const Contents> contents;
+	};
+
+	static bool SameContents(
+		const Contents& contents,
+		const glm::vec3* positions,
+		const glm::vec3* normals,
+		size_t vertex_count,
+		const GLuint* indices,
+		size_t index_count
+	);
+
+	// Drops the entries of released meshes
+	void Prune();
+
+	std::unordered_map<std::string, Entry> by_key;
+	std::unordered_map<uint64_t, Entry> by_content;
+	MeshRegistryStatistics statistics;
+};
@@ -0,0 +1,43 @@
+#include "mesh_streaming.h"
+
+#include <limits>
+#include <vector>
+
+/* Mesh Streaming */
+
+ParametricMeshSink CreateVAOSink(SharedVAO& vao, VertexFormat vertex_format)
+{
+	// The sink is copied around as a std::function, so the conversion buffer
+	// is shared between the copies
+	auto indices = std::make_shared<std::vector<GLuint>>();
+
+	return [&vao, vertex_format, indices](const ParametricMeshTile& tile)
+	{
+		if (tile.first_vertex == 0 && tile.first_index == 0)
+		{
+			uint64_t max_count = uint64_t(std::numeric_limits<GLsizei>::max());
+			if (tile.total_vertex_count > max_count || tile.total_index_count > max_count)
+			{
+				std::cout << "Error: Streamed mesh of " << tile.total_vertex_count << " vertices is too large for a VAO" << std::endl;
+				return false;
+			}
+
+			vao = SharedVAO(
+				new VAO(GLsizei(tile.total_vertex_count), GLsizei(tile.total_index_count), tile.bounding_radius, vertex_format),
+				[](VAO* vao)
+				{
+					DeleteVAO(*vao);
+					delete vao;
+				}
+			);
+		}
+
+		indices->assign(tile.indices, tile.indices + size_t(tile.index_count));
+		UploadVAO(
+			*vao,
+			GLsizei(tile.first_vertex), tile.positions, tile.normals, GLsizei(tile.vertex_count),
+			GLsizei(tile.first_index), indices->data(), GLsizei(tile.index_count)
+		);
+		return true;
+	};
+}
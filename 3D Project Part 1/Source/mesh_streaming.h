@@ -0,0 +1,15 @@
+#pragma once
+
+#include "GLM/glm.hpp"
+#include "GLAD/glad.h"
+#include "opengl_utilities.h"
+#include "mesh_generation.h"
+
+/* Mesh Streaming */
+
+// Sink that uploads a streamed mesh into vao one tile at a time, so only a
+// tile is ever held in host memory. The VAO is created on the first tile from
+// the mesh totals, with the same deleter as MeshRegistry uses; vao has to
+// outlive the generator call and the context has to be current throughout.
+// Stops the generator when the mesh needs more than 32-bit indices.
+ParametricMeshSink CreateVAOSink(SharedVAO& vao, VertexFormat vertex_format = VertexFormat::Float);
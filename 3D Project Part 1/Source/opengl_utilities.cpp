@@ -1,42 +1,917 @@
 #include "opengl_utilities.h"
 
+#include "GLM/gtc/packing.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include "GLM/gtc/type_ptr.hpp"
+
 /* OpenGL Utility Structs */
 
+// Bytes of one component, or of the whole attribute for the packed types
+static GLsizei TypeSize(GLenum type)
+{
+	switch (type)
+	{
+	case GL_BYTE:
+	case GL_UNSIGNED_BYTE:
+		return 1;
+	case GL_SHORT:
+	case GL_UNSIGNED_SHORT:
+	case GL_HALF_FLOAT:
+		return 2;
+	case GL_DOUBLE:
+		return 8;
+	default:
+		return 4;
+	}
+}
+
+static bool IsPackedType(GLenum type)
+{
+	return type == GL_INT_2_10_10_10_REV || type == GL_UNSIGNED_INT_2_10_10_10_REV || type == GL_UNSIGNED_INT_10F_11F_11F_REV;
+}
+
+GLuint VertexLayout::StreamCount() const
+{
+	GLuint stream_count = 0;
+	for (const auto& attribute : attributes)
+		stream_count = std::max(stream_count, attribute.stream + 1);
+	return stream_count;
+}
+
+GLsizei VertexLayout::Stride(GLuint stream) const
+{
+	GLsizei stride = 0;
+	for (size_t i = 0; i < attributes.size(); ++i)
+		if (attributes[i].stream == stream)
+			stride += AttributeSize(i);
+	return stride;
+}
+
+GLsizei VertexLayout::AttributeSize(size_t attribute) const
+{
+	const auto& a = attributes[attribute];
+	if (IsPackedType(a.type))
+		return 4;
+	return (a.component_count * TypeSize(a.type) + 3) & ~3;
+}
+
+GLsizei VertexLayout::AttributeOffset(size_t attribute) const
+{
+	GLsizei offset = 0;
+	for (size_t i = 0; i < attribute; ++i)
+		if (attributes[i].stream == attributes[attribute].stream)
+			offset += AttributeSize(i);
+	return offset;
+}
+
+VertexLayout MeshVertexLayout(VertexFormat vertex_format, VertexStreams vertex_streams)
+{
+	GLuint normal_stream = vertex_streams == VertexStreams::Interleaved ? 0 : 1;
+
+	VertexLayout layout;
+	if (vertex_format == VertexFormat::Compressed)
+		layout.attributes = {
+			{ 0, 3, GL_SHORT, GL_TRUE, 0 },
+			{ 1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, normal_stream },
+		};
+	else
+		layout.attributes = {
+			{ 0, 3, GL_FLOAT, GL_FALSE, 0 },
+			{ 1, 3, GL_FLOAT, GL_FALSE, normal_stream },
+		};
+	return layout;
+}
+
+// Copies count elements of Size bytes from a packed array to every stride
+// bytes of target
+template<size_t Size>
+static void CopyStrided(const char* source, char* target, GLsizei stride, GLsizei count)
+{
+	for (GLsizei i = 0; i < count; ++i)
+		std::memcpy(target + size_t(i) * stride, source + size_t(i) * Size, Size);
+}
+
+// Writes the attributes of stream for vertices [0, vertex_count) from their
+// packed arrays to destination in the layout of the stream
+static void InterleaveStream(const VertexLayout& layout, GLuint stream, const void* const* attribute_data, GLsizei vertex_count, void* destination)
+{
+	GLsizei stride = layout.Stride(stream);
+	for (size_t i = 0; i < layout.attributes.size(); ++i)
+	{
+		if (layout.attributes[i].stream != stream)
+			continue;
+
+		GLsizei size = layout.AttributeSize(i);
+		auto source = static_cast<const char*>(attribute_data[i]);
+		auto target = static_cast<char*>(destination) + layout.AttributeOffset(i);
+
+		if (size == stride)
+			std::memcpy(target, source, size_t(vertex_count) * size);
+		else if (size == 4)
+			CopyStrided<4>(source, target, stride, vertex_count);
+		else if (size == 8)
+			CopyStrided<8>(source, target, stride, vertex_count);
+		else if (size == 12)
+			CopyStrided<12>(source, target, stride, vertex_count);
+		else if (size == 16)
+			CopyStrided<16>(source, target, stride, vertex_count);
+		else
+			for (GLsizei v = 0; v < vertex_count; ++v)
+				std::memcpy(target + size_t(v) * stride, source + size_t(v) * size, size);
+	}
+}
+
+// The contents of stream: an attribute that has the stream to itself is
+// already laid out, anything else is interleaved into scratch
+static const void* StreamData(const VertexLayout& layout, GLuint stream, const void* const* attribute_data, GLsizei vertex_count, std::vector<char>& scratch)
+{
+	GLsizei stride = layout.Stride(stream);
+	for (size_t i = 0; i < layout.attributes.size(); ++i)
+		if (layout.attributes[i].stream == stream && layout.AttributeSize(i) == stride)
+			return attribute_data[i];
+
+	scratch.resize(size_t(vertex_count) * stride);
+	InterleaveStream(layout, stream, attribute_data, vertex_count, scratch.data());
+	return scratch.data();
+}
+
+// Narrowest index type that can address vertex_count vertices, keeping the
+// all-ones index free for primitive restart in strips
+static GLenum ElementArrayType(GLsizei vertex_count, GLenum primitive_mode)
+{
+	GLsizei max_vertex_count = primitive_mode == GL_TRIANGLE_STRIP ? 0xFFFF : 0x10000;
+	return vertex_count <= max_vertex_count ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+static GLsizeiptr ElementSize(GLenum element_array_type)
+{
+	return element_array_type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+}
+
+// Normalized 16-bit positions within position_scale of position_offset, and
+// normals as 10:10:10:2
+static void QuantizeVertices(
+	const glm::vec3* positions,
+	const glm::vec3* normals,
+	GLsizei vertex_count,
+	glm::vec3 position_scale,
+	glm::vec3 position_offset,
+	glm::i16vec4* packed_positions,
+	GLuint* packed_normals
+)
+{
+	for (GLsizei i = 0; i < vertex_count; ++i)
+	{
+		auto q = glm::round(glm::clamp((positions[i] - position_offset) / position_scale, -1.f, 1.f) * 32767.f);
+		packed_positions[i] = glm::i16vec4(glm::ivec3(q), 0);
+		packed_normals[i] = glm::packSnorm3x10_1x2(glm::vec4(normals[i], 0));
+	}
+}
+
 VAO::VAO(
 	const std::vector<glm::vec3>& positions,
 	const std::vector<glm::vec3>& normals,
-	const std::vector<GLuint>& indices
+	const std::vector<GLuint>& indices,
+	VertexFormat vertex_format,
+	GLenum primitive_mode,
+	VertexStreams vertex_streams
 )
 {
-	glGenVertexArrays(1, &id);
-	glBindVertexArray(id);
-
+	this->vertex_format = vertex_format;
+	this->primitive_mode = primitive_mode;
+	vertex_layout = MeshVertexLayout(vertex_format, vertex_streams);
 	vertex_count = GLsizei(positions.size());
+	element_array_count = GLsizei(indices.size());
+	element_array_type = ElementArrayType(vertex_count, primitive_mode);
+	position_scale = glm::vec3(1);
+	position_offset = glm::vec3(0);
+
+	const void* vertex_data[] = { positions.data(), normals.data() };
+	std::vector<glm::i16vec4> packed_positions;
+	std::vector<GLuint> packed_normals;
+	if (vertex_format == VertexFormat::Compressed)
+	{
+		packed_positions.resize(vertex_count);
+		packed_normals.resize(vertex_count);
+		PackVertices(positions.data(), normals.data(), packed_positions.data(), packed_normals.data());
+		vertex_data[0] = packed_positions.data();
+		vertex_data[1] = packed_normals.data();
+	}
+
+	const void* index_data = indices.data();
+	std::vector<GLushort> short_indices;
+	if (element_array_type == GL_UNSIGNED_SHORT)
+	{
+		short_indices.assign(indices.begin(), indices.end());
+		index_data = short_indices.data();
+	}
 
-	glGenBuffers(1, &position_buffer);
-	glBindBuffer(GL_ARRAY_BUFFER, position_buffer);
-	glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3), positions.data(), GL_STATIC_DRAW);
+	CreateBuffers(vertex_data, index_data);
+};
+
+VAO::VAO(
+	const VertexLayout& vertex_layout,
+	GLsizei vertex_count,
+	const void* const* attribute_data,
+	const std::vector<GLuint>& indices,
+	GLenum primitive_mode
+)
+{
+	vertex_format = VertexFormat::Float;
+	this->vertex_layout = vertex_layout;
+	this->primitive_mode = primitive_mode;
+	this->vertex_count = vertex_count;
+	element_array_count = GLsizei(indices.size());
+	element_array_type = ElementArrayType(vertex_count, primitive_mode);
+	position_scale = glm::vec3(1);
+	position_offset = glm::vec3(0);
+
+	const void* index_data = indices.data();
+	std::vector<GLushort> short_indices;
+	if (element_array_type == GL_UNSIGNED_SHORT)
+	{
+		short_indices.assign(indices.begin(), indices.end());
+		index_data = short_indices.data();
+	}
+
+	CreateBuffers(attribute_data, index_data);
+}
+
+VAO::VAO(
+	GLsizei vertex_count,
+	GLsizei element_array_count,
+	const VAOFill& fill,
+	VertexFormat vertex_format,
+	GLenum primitive_mode,
+	VertexStreams vertex_streams
+)
+{
+	this->vertex_format = vertex_format;
+	this->primitive_mode = primitive_mode;
+	this->vertex_count = vertex_count;
+	this->element_array_count = element_array_count;
+	vertex_layout = MeshVertexLayout(vertex_format, vertex_streams);
+	element_array_type = ElementArrayType(vertex_count, primitive_mode);
+	position_scale = glm::vec3(1);
+	position_offset = glm::vec3(0);
 
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, static_cast<void *>(0));
-	glEnableVertexAttribArray(0);
+	CreateBuffers(nullptr, nullptr);
 
+	GLuint stream_count = vertex_layout.StreamCount();
+	GLsizeiptr indices_size = element_array_count * ElementSize(element_array_type);
+	GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT;
 
-	glGenBuffers(1, &normals_buffer);
-	glBindBuffer(GL_ARRAY_BUFFER, normals_buffer);
-	glBufferData(GL_ARRAY_BUFFER, normals.size() * sizeof(glm::vec3), normals.data(), GL_STATIC_DRAW);
+	// A buffer stays mapped when another is bound to the target in its place,
+	// so the streams all go through the array buffer target; the VAO keeps
+	// the element array binding.
+	std::vector<void*> mapped_streams(stream_count);
+	bool mapped = true;
+	for (GLuint stream = 0; stream < stream_count; ++stream)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, vertex_buffers[stream]);
+		mapped_streams[stream] = glMapBufferRange(GL_ARRAY_BUFFER, 0, GLsizeiptr(vertex_count) * vertex_layout.Stride(stream), access);
+		mapped &= mapped_streams[stream] != NULL;
+	}
+	auto mapped_indices = glMapBufferRange(GL_ELEMENT_ARRAY_BUFFER, 0, indices_size, access);
+	mapped &= mapped_indices != NULL;
 
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, static_cast<void *>(0));
-	glEnableVertexAttribArray(1);
+	if (mapped)
+		FillBuffers(fill, mapped_streams.data(), mapped_indices);
 
+	// Unmap everything that did map; GL_FALSE means the store was lost
+	for (GLuint stream = 0; stream < stream_count; ++stream)
+	{
+		if (mapped_streams[stream] == NULL)
+			continue;
+		glBindBuffer(GL_ARRAY_BUFFER, vertex_buffers[stream]);
+		mapped &= glUnmapBuffer(GL_ARRAY_BUFFER) == GL_TRUE;
+	}
+	if (mapped_indices != NULL)
+		mapped &= glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER) == GL_TRUE;
+
+	if (!mapped)
+	{
+		std::cout << "Warning: Buffer mapping failed, generating through host memory" << std::endl;
+
+		std::vector<std::vector<char>> streams(stream_count);
+		std::vector<void*> stream_data(stream_count);
+		for (GLuint stream = 0; stream < stream_count; ++stream)
+		{
+			streams[stream].resize(GLsizeiptr(vertex_count) * vertex_layout.Stride(stream));
+			stream_data[stream] = streams[stream].data();
+		}
+		std::vector<char> indices(indices_size);
+		FillBuffers(fill, stream_data.data(), indices.data());
+
+		for (GLuint stream = 0; stream < stream_count; ++stream)
+		{
+			glBindBuffer(GL_ARRAY_BUFFER, vertex_buffers[stream]);
+			glBufferSubData(GL_ARRAY_BUFFER, 0, streams[stream].size(), streams[stream].data());
+		}
+		glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, indices_size, indices.data());
+	}
+}
+
+VAO::VAO(
+	GLsizei vertex_count,
+	GLsizei element_array_count,
+	float position_bound,
+	VertexFormat vertex_format,
+	GLenum primitive_mode,
+	VertexStreams vertex_streams
+)
+{
+	this->vertex_format = vertex_format;
+	this->primitive_mode = primitive_mode;
+	this->vertex_count = vertex_count;
+	this->element_array_count = element_array_count;
+	vertex_layout = MeshVertexLayout(vertex_format, vertex_streams);
+	element_array_type = ElementArrayType(vertex_count, primitive_mode);
+	position_scale = glm::vec3(1);
+	position_offset = glm::vec3(0);
+	if (vertex_format == VertexFormat::Compressed)
+		position_scale = glm::vec3(std::max(position_bound, 1e-30f));
+
+	CreateBuffers(nullptr, nullptr);
+}
+
+// Meshes needing 32-bit indices in a 16-bit arena get buffers of their own.
+// The arena's buffers may be reallocated by a later mesh, so the fill goes
+// through host memory rather than a mapping.
+VAO::VAO(
+	GeometryArena& arena,
+	GLsizei vertex_count,
+	GLsizei element_array_count,
+	const VAOFill& fill,
+	GLenum primitive_mode
+)
+{
+	if (arena.element_array_type == GL_UNSIGNED_SHORT && ElementArrayType(vertex_count, primitive_mode) == GL_UNSIGNED_INT)
+	{
+		*this = VAO(vertex_count, element_array_count, fill, arena.vertex_format, primitive_mode, arena.vertex_streams);
+		return;
+	}
+
+	this->vertex_format = arena.vertex_format;
+	this->primitive_mode = primitive_mode;
+	this->vertex_count = vertex_count;
+	this->element_array_count = element_array_count;
+	vertex_layout = arena.vertex_layout;
+	element_array_type = arena.element_array_type;
+	position_scale = glm::vec3(1);
+	position_offset = glm::vec3(0);
+
+	allocation = arena.Allocate(vertex_count, element_array_count);
+	id = arena.vertex_array;
+	vertex_buffers = arena.vertex_buffers;
+	element_array_buffer = arena.element_array_buffer;
+
+	GLuint stream_count = vertex_layout.StreamCount();
+	std::vector<std::vector<char>> streams(stream_count);
+	std::vector<void*> stream_data(stream_count);
+	for (GLuint stream = 0; stream < stream_count; ++stream)
+	{
+		streams[stream].resize(GLsizeiptr(vertex_count) * vertex_layout.Stride(stream));
+		stream_data[stream] = streams[stream].data();
+	}
+	std::vector<char> indices(element_array_count * ElementSize(element_array_type));
+	FillBuffers(fill, stream_data.data(), indices.data());
+
+	for (GLuint stream = 0; stream < stream_count; ++stream)
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, vertex_buffers[stream]);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, allocation->first_vertex * GLsizeiptr(vertex_layout.Stride(stream)), streams[stream].size(), streams[stream].data());
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, element_array_buffer);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, allocation->first_index * ElementSize(element_array_type), indices.size(), indices.data());
+}
+
+// Creates a vertex array with a buffer per stream of layout for vertex_count
+// vertices and an index buffer of element_array_size bytes, and points every
+// attribute at its stream. Null data leaves the buffers' contents undefined.
+static void CreateVertexArray(
+	const VertexLayout& layout,
+	GLsizei vertex_count,
+	const void* const* attribute_data,
+	GLsizeiptr element_array_size,
+	const void* indices,
+	GLuint& vertex_array,
+	std::vector<GLuint>& vertex_buffers,
+	GLuint& element_array_buffer
+)
+{
+	glGenVertexArrays(1, &vertex_array);
+	glBindVertexArray(vertex_array);
+
+	GLuint stream_count = layout.StreamCount();
+	vertex_buffers.resize(stream_count);
+	glGenBuffers(stream_count, vertex_buffers.data());
+
+	std::vector<char> scratch;
+	for (GLuint stream = 0; stream < stream_count; ++stream)
+	{
+		const void* data = attribute_data ? StreamData(layout, stream, attribute_data, vertex_count, scratch) : nullptr;
+		glBindBuffer(GL_ARRAY_BUFFER, vertex_buffers[stream]);
+		glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(vertex_count) * layout.Stride(stream), data, GL_STATIC_DRAW);
+	}
+
+	for (size_t i = 0; i < layout.attributes.size(); ++i)
+	{
+		const auto& attribute = layout.attributes[i];
+		glBindBuffer(GL_ARRAY_BUFFER, vertex_buffers[attribute.stream]);
+		glVertexAttribPointer(
+			attribute.location,
+			attribute.component_count,
+			attribute.type,
+			attribute.normalized,
+			layout.Stride(attribute.stream),
+			reinterpret_cast<void *>(size_t(layout.AttributeOffset(i)))
+		);
+		glEnableVertexAttribArray(attribute.location);
+	}
 
-	element_array_count = GLsizei(indices.size());
 
 	glGenBuffers(1, &element_array_buffer);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, element_array_buffer);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
-};
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, element_array_size, indices, GL_STATIC_DRAW);
+}
+
+// Writes vertices [first_vertex, first_vertex + vertex_count) of vao from an
+// array per attribute already in the attribute's type, and indices likewise,
+// narrowing them to element_array_type. Both count from the start of the
+// VAO's allocation when it has one. Leaves the bound VAO alone by going
+// through the copy target.
+static void WriteVertices(const VAO& vao, GLsizei first_vertex, const void* const* attribute_data, GLsizei vertex_count)
+{
+	if (vao.allocation)
+		first_vertex += vao.allocation->first_vertex;
+
+	// The vertices of an interleaved range are contiguous in their stream
+	std::vector<char> scratch;
+	for (GLuint stream = 0; stream < GLuint(vao.vertex_buffers.size()); ++stream)
+	{
+		GLsizeiptr stride = vao.vertex_layout.Stride(stream);
+		const void* data = StreamData(vao.vertex_layout, stream, attribute_data, vertex_count, scratch);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, vao.vertex_buffers[stream]);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, first_vertex * stride, vertex_count * stride, data);
+	}
+}
+
+static void WriteIndices(const VAO& vao, GLsizei first_index, const GLuint* indices, GLsizei index_count)
+{
+	if (vao.allocation)
+		first_index += vao.allocation->first_index;
+
+	const void* index_data = indices;
+	std::vector<GLushort> short_indices;
+	if (vao.element_array_type == GL_UNSIGNED_SHORT)
+	{
+		short_indices.assign(indices, indices + index_count);
+		index_data = short_indices.data();
+	}
+
+	GLsizeiptr element_size = ElementSize(vao.element_array_type);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, vao.element_array_buffer);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, first_index * element_size, index_count * element_size, index_data);
+}
+
+void VAO::CreateBuffers(const void* const* attribute_data, const void* indices)
+{
+	CreateVertexArray(
+		vertex_layout, vertex_count, attribute_data,
+		element_array_count * ElementSize(element_array_type), indices,
+		id, vertex_buffers, element_array_buffer
+	);
+}
+
+// Runs fill into streams laid out as vertex_layout and indices of
+// element_array_type, going through host memory for whatever has to be
+// packed or interleaved
+void VAO::FillBuffers(const VAOFill& fill, void* const* streams, void* indices)
+{
+	const auto& position = vertex_layout.attributes[0];
+	const auto& normal = vertex_layout.attributes[1];
+	bool in_place = vertex_format == VertexFormat::Float &&
+		vertex_layout.AttributeSize(0) == vertex_layout.Stride(position.stream) &&
+		vertex_layout.AttributeSize(1) == vertex_layout.Stride(normal.stream);
+	bool pack_indices = element_array_type != GL_UNSIGNED_INT;
+
+	std::vector<glm::vec3> float_positions(in_place ? 0 : vertex_count);
+	std::vector<glm::vec3> float_normals(in_place ? 0 : vertex_count);
+	std::vector<GLuint> int_indices(pack_indices ? element_array_count : 0);
+
+	fill(
+		in_place ? static_cast<glm::vec3 *>(streams[position.stream]) : float_positions.data(),
+		in_place ? static_cast<glm::vec3 *>(streams[normal.stream]) : float_normals.data(),
+		pack_indices ? int_indices.data() : static_cast<GLuint *>(indices)
+	);
+
+	if (!in_place)
+	{
+		const void* vertex_data[] = { float_positions.data(), float_normals.data() };
+		std::vector<glm::i16vec4> packed_positions;
+		std::vector<GLuint> packed_normals;
+		if (vertex_format == VertexFormat::Compressed)
+		{
+			packed_positions.resize(vertex_count);
+			packed_normals.resize(vertex_count);
+			PackVertices(float_positions.data(), float_normals.data(), packed_positions.data(), packed_normals.data());
+			vertex_data[0] = packed_positions.data();
+			vertex_data[1] = packed_normals.data();
+		}
+
+		for (GLuint stream = 0; stream < vertex_layout.StreamCount(); ++stream)
+			InterleaveStream(vertex_layout, stream, vertex_data, vertex_count, streams[stream]);
+	}
+	// Truncation maps the 32-bit restart index to the 16-bit one
+	if (pack_indices)
+		std::copy(int_indices.begin(), int_indices.end(), static_cast<GLushort *>(indices));
+}
+
+// Quantizes positions to the mesh bounds and packs normals to 10:10:10:2,
+// setting position_scale / position_offset to undo the quantization.
+// Positions decode to within 1/65534 of the mesh extent and normal components
+// to within 1/511, under either of the GL signed normalized conversion rules.
+void VAO::PackVertices(const glm::vec3* positions, const glm::vec3* normals, glm::i16vec4* packed_positions, GLuint* packed_normals)
+{
+	glm::vec3 lower(0), upper(0);
+	if (vertex_count > 0)
+		lower = upper = positions[0];
+	for (GLsizei i = 1; i < vertex_count; ++i)
+	{
+		lower = glm::min(lower, positions[i]);
+		upper = glm::max(upper, positions[i]);
+	}
+
+	position_offset = (upper + lower) / 2.f;
+	position_scale = glm::max((upper - lower) / 2.f, glm::vec3(1e-30f));
+
+	QuantizeVertices(positions, normals, vertex_count, position_scale, position_offset, packed_positions, packed_normals);
+}
+
+GeometryAllocation::~GeometryAllocation()
+{
+	arena->Free(*this);
+}
+
+// First fit; an empty range is always at offset 0 so it needs no space
+static bool TakeRange(std::map<GLsizei, GLsizei>& free_ranges, GLsizei size, GLsizei& offset)
+{
+	if (size == 0)
+	{
+		offset = 0;
+		return true;
+	}
+
+	for (auto range = free_ranges.begin(); range != free_ranges.end(); ++range)
+	{
+		if (range->second < size)
+			continue;
+
+		offset = range->first;
+		GLsizei remaining = range->second - size;
+		free_ranges.erase(range);
+		if (remaining > 0)
+			free_ranges[offset + size] = remaining;
+		return true;
+	}
+	return false;
+}
+
+// Merges the range with the free ones either side of it
+static void ReturnRange(std::map<GLsizei, GLsizei>& free_ranges, GLsizei offset, GLsizei size)
+{
+	if (size == 0)
+		return;
+
+	auto next = free_ranges.lower_bound(offset);
+	if (next != free_ranges.end() && offset + size == next->first)
+	{
+		size += next->second;
+		next = free_ranges.erase(next);
+	}
+	if (next != free_ranges.begin())
+	{
+		auto previous = std::prev(next);
+		if (previous->first + previous->second == offset)
+		{
+			previous->second += size;
+			return;
+		}
+	}
+	free_ranges[offset] = size;
+}
+
+static GLsizei FreeSpace(const std::map<GLsizei, GLsizei>& free_ranges)
+{
+	GLsizei size = 0;
+	for (const auto& range : free_ranges)
+		size += range.second;
+	return size;
+}
+
+GeometryArena::GeometryArena(
+	VertexFormat vertex_format,
+	GLenum element_array_type,
+	GLsizei vertex_capacity,
+	GLsizei index_capacity,
+	VertexStreams vertex_streams
+)
+{
+	this->vertex_format = vertex_format;
+	this->vertex_streams = vertex_streams;
+	this->element_array_type = element_array_type;
+	this->vertex_capacity = vertex_capacity;
+	this->index_capacity = index_capacity;
+	vertex_layout = MeshVertexLayout(vertex_format, vertex_streams);
+
+	CreateVertexArray(
+		vertex_layout, vertex_capacity, nullptr,
+		index_capacity * ElementSize(element_array_type), nullptr,
+		vertex_array, vertex_buffers, element_array_buffer
+	);
+
+	if (vertex_capacity > 0)
+		free_vertices[0] = vertex_capacity;
+	if (index_capacity > 0)
+		free_indices[0] = index_capacity;
+}
+
+// Compacting is cheaper than growing, so the buffers only grow when the free
+// space wouldn't fit the mesh even in one piece
+std::shared_ptr<GeometryAllocation> GeometryArena::Allocate(GLsizei vertex_count, GLsizei index_count)
+{
+	GLsizei first_vertex = 0, first_index = 0;
+	bool fits = false;
+	for (int attempt = 0; attempt < 2 && !fits; ++attempt)
+	{
+		fits = TakeRange(free_vertices, vertex_count, first_vertex);
+		if (fits && !TakeRange(free_indices, index_count, first_index))
+		{
+			ReturnRange(free_vertices, first_vertex, vertex_count);
+			fits = false;
+		}
+		if (fits || attempt > 0)
+			continue;
+
+		if (FreeSpace(free_vertices) >= vertex_count && FreeSpace(free_indices) >= index_count)
+		{
+			Defragment();
+		}
+		else
+		{
+			GLsizei used_vertices = vertex_capacity - FreeSpace(free_vertices);
+			GLsizei used_indices = index_capacity - FreeSpace(free_indices);
+			Grow(
+				std::max(2 * vertex_capacity, used_vertices + vertex_count),
+				std::max(2 * index_capacity, used_indices + index_count)
+			);
+		}
+	}
+
+	// Both retries are sized to fit, and a failed TakeRange changes nothing
+	auto allocation = std::make_shared<GeometryAllocation>();
+	allocation->arena = this;
+	allocation->first_vertex = first_vertex;
+	allocation->vertex_count = vertex_count;
+	allocation->first_index = first_index;
+	allocation->index_count = index_count;
+	allocations.push_back(allocation.get());
+	return allocation;
+}
+
+void GeometryArena::Free(const GeometryAllocation& allocation)
+{
+	ReturnRange(free_vertices, allocation.first_vertex, allocation.vertex_count);
+	ReturnRange(free_indices, allocation.first_index, allocation.index_count);
+	allocations.erase(std::find(allocations.begin(), allocations.end(), &allocation));
+}
+
+// Buffer names stay the same, so the vertex array and every VAO holding them
+// stay valid; only the stores are replaced
+static void ResizeBuffer(GLuint buffer, GLsizeiptr old_size, GLsizeiptr new_size)
+{
+	GLuint temporary;
+	glGenBuffers(1, &temporary);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, temporary);
+	glBufferData(GL_COPY_WRITE_BUFFER, old_size, NULL, GL_STREAM_COPY);
+	glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, old_size);
+
+	glBufferData(GL_COPY_READ_BUFFER, new_size, NULL, GL_STATIC_DRAW);
+	glCopyBufferSubData(GL_COPY_WRITE_BUFFER, GL_COPY_READ_BUFFER, 0, 0, old_size);
+	glDeleteBuffers(1, &temporary);
+}
+
+void GeometryArena::Grow(GLsizei vertex_capacity, GLsizei index_capacity)
+{
+	for (GLuint stream = 0; stream < GLuint(vertex_buffers.size()); ++stream)
+	{
+		GLsizeiptr stride = vertex_layout.Stride(stream);
+		ResizeBuffer(vertex_buffers[stream], this->vertex_capacity * stride, vertex_capacity * stride);
+	}
+	GLsizeiptr element_size = ElementSize(element_array_type);
+	ResizeBuffer(element_array_buffer, this->index_capacity * element_size, index_capacity * element_size);
+
+	ReturnRange(free_vertices, this->vertex_capacity, vertex_capacity - this->vertex_capacity);
+	ReturnRange(free_indices, this->index_capacity, index_capacity - this->index_capacity);
+	this->vertex_capacity = vertex_capacity;
+	this->index_capacity = index_capacity;
+	grows++;
+}
+
+// Packs the ranges, each given by offset and size in elements of
+// element_size, into a temporary buffer in the order given and copies the
+// result back to the start of buffer
+static void CompactBuffer(GLuint buffer, GLsizeiptr element_size, const std::vector<std::pair<GLsizei, GLsizei>>& ranges)
+{
+	GLsizeiptr packed_size = 0;
+	for (const auto& range : ranges)
+		packed_size += range.second * element_size;
+	if (packed_size == 0)
+		return;
+
+	GLuint temporary;
+	glGenBuffers(1, &temporary);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, temporary);
+	glBufferData(GL_COPY_WRITE_BUFFER, packed_size, NULL, GL_STREAM_COPY);
+	glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+
+	GLsizeiptr offset = 0;
+	for (const auto& range : ranges)
+	{
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, range.first * element_size, offset, range.second * element_size);
+		offset += range.second * element_size;
+	}
+	glCopyBufferSubData(GL_COPY_WRITE_BUFFER, GL_COPY_READ_BUFFER, 0, 0, packed_size);
+	glDeleteBuffers(1, &temporary);
+}
+
+// Indices are relative to the base vertex, so moving vertices needs no change
+// to them
+void GeometryArena::Defragment()
+{
+	std::vector<GeometryAllocation*> by_vertex(allocations), by_index(allocations);
+	std::sort(by_vertex.begin(), by_vertex.end(), [](const GeometryAllocation* a, const GeometryAllocation* b) { return a->first_vertex < b->first_vertex; });
+	std::sort(by_index.begin(), by_index.end(), [](const GeometryAllocation* a, const GeometryAllocation* b) { return a->first_index < b->first_index; });
+
+	std::vector<std::pair<GLsizei, GLsizei>> ranges;
+	for (auto allocation : by_vertex)
+		ranges.emplace_back(allocation->first_vertex, allocation->vertex_count);
+	for (GLuint stream = 0; stream < GLuint(vertex_buffers.size()); ++stream)
+		CompactBuffer(vertex_buffers[stream], vertex_layout.Stride(stream), ranges);
+
+	ranges.clear();
+	for (auto allocation : by_index)
+		ranges.emplace_back(allocation->first_index, allocation->index_count);
+	CompactBuffer(element_array_buffer, ElementSize(element_array_type), ranges);
+
+	GLsizei used_vertices = 0, used_indices = 0;
+	for (auto allocation : by_vertex)
+	{
+		allocation->first_vertex = allocation->vertex_count > 0 ? used_vertices : 0;
+		used_vertices += allocation->vertex_count;
+	}
+	for (auto allocation : by_index)
+	{
+		allocation->first_index = allocation->index_count > 0 ? used_indices : 0;
+		used_indices += allocation->index_count;
+	}
+
+	free_vertices.clear();
+	free_indices.clear();
+	if (used_vertices < vertex_capacity)
+		free_vertices[used_vertices] = vertex_capacity - used_vertices;
+	if (used_indices < index_capacity)
+		free_indices[used_indices] = index_capacity - used_indices;
+	defragmentations++;
+}
+
+GeometryArenaStatistics GeometryArena::Statistics() const
+{
+	GeometryArenaStatistics statistics;
+	statistics.vertex_capacity = vertex_capacity;
+	statistics.index_capacity = index_capacity;
+	statistics.used_vertices = vertex_capacity - FreeSpace(free_vertices);
+	statistics.used_indices = index_capacity - FreeSpace(free_indices);
+	statistics.allocations = allocations.size();
+	statistics.free_vertex_ranges = free_vertices.size();
+	statistics.free_index_ranges = free_indices.size();
+	statistics.grows = grows;
+	statistics.defragmentations = defragmentations;
+	return statistics;
+}
 
 /* OpenGL Utility Functions */
+GLsizeiptr VAOBufferSize(const VAO& vao)
+{
+	GLsizeiptr size = vao.element_array_count * ElementSize(vao.element_array_type);
+	for (GLuint stream = 0; stream < GLuint(vao.vertex_buffers.size()); ++stream)
+		size += GLsizeiptr(vao.vertex_count) * vao.vertex_layout.Stride(stream);
+	return size;
+}
+
+void DeleteVAO(VAO& vao)
+{
+	if (vao.allocation)
+	{
+		vao.allocation.reset();
+	}
+	else
+	{
+		glDeleteBuffers(GLsizei(vao.vertex_buffers.size()), vao.vertex_buffers.data());
+		glDeleteBuffers(1, &vao.element_array_buffer);
+		glDeleteVertexArrays(1, &vao.id);
+	}
+
+	vao.id = 0;
+	vao.vertex_buffers.clear();
+	vao.element_array_buffer = 0;
+}
+
+void DeleteGeometryArena(GeometryArena& arena)
+{
+	glDeleteBuffers(GLsizei(arena.vertex_buffers.size()), arena.vertex_buffers.data());
+	glDeleteBuffers(1, &arena.element_array_buffer);
+	glDeleteVertexArrays(1, &arena.vertex_array);
+
+	arena.vertex_array = 0;
+	arena.vertex_buffers.clear();
+	arena.element_array_buffer = 0;
+}
+
+void UploadVAO(
+	const VAO& vao,
+	GLsizei first_vertex,
+	const glm::vec3* positions,
+	const glm::vec3* normals,
+	GLsizei vertex_count,
+	GLsizei first_index,
+	const GLuint* indices,
+	GLsizei index_count
+)
+{
+	const void* vertex_data[] = { positions, normals };
+	std::vector<glm::i16vec4> packed_positions;
+	std::vector<GLuint> packed_normals;
+	if (vao.vertex_format == VertexFormat::Compressed)
+	{
+		packed_positions.resize(vertex_count);
+		packed_normals.resize(vertex_count);
+		QuantizeVertices(positions, normals, vertex_count, vao.position_scale, vao.position_offset, packed_positions.data(), packed_normals.data());
+		vertex_data[0] = packed_positions.data();
+		vertex_data[1] = packed_normals.data();
+	}
+
+	WriteVertices(vao, first_vertex, vertex_data, vertex_count);
+	WriteIndices(vao, first_index, indices, index_count);
+}
+
+static const UniformName UniformPositionScale("u_position_scale");
+static const UniformName UniformPositionOffset("u_position_offset");
+
+void BindVAO(const VAO& vao, const Program& program)
+{
+	glBindVertexArray(vao.id);
+
+	program.Set(UniformPositionScale, vao.position_scale);
+	program.Set(UniformPositionOffset, vao.position_offset);
+}
+
+void DrawVAO(const VAO& vao)
+{
+	// Lists leave restart off, 0xFFFF is a real vertex in a 65536 vertex mesh
+	if (vao.primitive_mode == GL_TRIANGLE_STRIP)
+	{
+		glEnable(GL_PRIMITIVE_RESTART);
+		glPrimitiveRestartIndex(vao.element_array_type == GL_UNSIGNED_SHORT ? 0xFFFF : 0xFFFFFFFF);
+	}
+	else
+	{
+		glDisable(GL_PRIMITIVE_RESTART);
+	}
+
+	GLint base_vertex = 0;
+	GLsizeiptr first_index = 0;
+	if (vao.allocation)
+	{
+		base_vertex = vao.allocation->first_vertex;
+		first_index = vao.allocation->first_index;
+	}
+
+	// The restart index is compared before the base vertex is added
+	glDrawElementsBaseVertex(
+		vao.primitive_mode,
+		vao.element_array_count,
+		vao.element_array_type,
+		reinterpret_cast<void *>(first_index * ElementSize(vao.element_array_type)),
+		base_vertex
+	);
+}
+
 GLuint CreateShaderFromSource(const GLenum& shader_type, const GLchar * source)
 {
 	GLuint shader = glCreateShader(shader_type);
@@ -54,23 +929,22 @@ GLuint CreateShaderFromSource(const GLenum& shader_type, const GLchar * source)
 		std::cout << info_log << std::endl;
 
 		glDeleteShader(shader);
-		return NULL;
+		return 0;
 	}
 
 	return shader;
 }
 
-GLuint CreateProgramFromSources(const GLchar * vertex_shader_source, const GLchar * fragment_shader_source)
+// Links the compiled shaders into a program, or returns 0 if any failed
+static GLuint LinkProgram(const GLuint* shaders, int shader_count)
 {
-	GLuint vertex_shader = CreateShaderFromSource(GL_VERTEX_SHADER, vertex_shader_source);
-	GLuint fragment_shader = CreateShaderFromSource(GL_FRAGMENT_SHADER, fragment_shader_source);
-
-	if (vertex_shader == NULL || fragment_shader == NULL)
-		return NULL;
+	for (int i = 0; i < shader_count; ++i)
+		if (shaders[i] == 0)
+			return 0;
 
 	GLuint program = glCreateProgram();
-	glAttachShader(program, vertex_shader);
-	glAttachShader(program, fragment_shader);
+	for (int i = 0; i < shader_count; ++i)
+		glAttachShader(program, shaders[i]);
 	glLinkProgram(program);
 
 	int success;
@@ -84,8 +958,172 @@ GLuint CreateProgramFromSources(const GLchar * vertex_shader_source, const GLcha
 		std::cout << info_log << std::endl;
 
 		glDeleteProgram(program);
-		return NULL;
+		return 0;
 	}
 
 	return program;
-}
\ No newline at end of file
+}
+
+// Every name interned so far, by index. Function statics, so UniformNames in
+// other files can be constructed in any order.
+static std::vector<std::string>& UniformNames()
+{
+	static std::vector<std::string> names;
+	return names;
+}
+
+static std::unordered_map<std::string, size_t>& UniformIndices()
+{
+	static std::unordered_map<std::string, size_t> indices;
+	return indices;
+}
+
+UniformName::UniformName(const char* name)
+{
+	auto inserted = UniformIndices().emplace(name, UniformNames().size());
+	if (inserted.second)
+		UniformNames().push_back(name);
+	index = inserted.first->second;
+}
+
+// Both queries report a max name length including the terminator
+static std::vector<ProgramVariable> ActiveVariables(GLuint id, bool uniforms)
+{
+	GLint count = 0, max_length = 0;
+	glGetProgramiv(id, uniforms ? GL_ACTIVE_UNIFORMS : GL_ACTIVE_ATTRIBUTES, &count);
+	glGetProgramiv(id, uniforms ? GL_ACTIVE_UNIFORM_MAX_LENGTH : GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &max_length);
+
+	std::vector<ProgramVariable> variables(count);
+	std::vector<GLchar> name(std::max(max_length, 1));
+	for (GLint i = 0; i < count; ++i)
+	{
+		auto& variable = variables[i];
+		GLsizei length = 0;
+		if (uniforms)
+			glGetActiveUniform(id, GLuint(i), GLsizei(name.size()), &length, &variable.size, &variable.type, name.data());
+		else
+			glGetActiveAttrib(id, GLuint(i), GLsizei(name.size()), &length, &variable.size, &variable.type, name.data());
+
+		variable.name.assign(name.data(), length);
+		variable.location = uniforms
+			? glGetUniformLocation(id, variable.name.c_str())
+			: glGetAttribLocation(id, variable.name.c_str());
+
+		auto array_suffix = variable.name.rfind("[0]");
+		if (array_suffix != std::string::npos && array_suffix + 3 == variable.name.size())
+			variable.name.resize(array_suffix);
+	}
+
+	if (uniforms && count > 0)
+	{
+		std::vector<GLuint> indices(count);
+		std::vector<GLint> block_indices(count), offsets(count);
+		for (GLint i = 0; i < count; ++i)
+			indices[i] = GLuint(i);
+		glGetActiveUniformsiv(id, count, indices.data(), GL_UNIFORM_BLOCK_INDEX, block_indices.data());
+		glGetActiveUniformsiv(id, count, indices.data(), GL_UNIFORM_OFFSET, offsets.data());
+		for (GLint i = 0; i < count; ++i)
+		{
+			variables[i].block_index = block_indices[i];
+			variables[i].offset = offsets[i];
+		}
+	}
+	return variables;
+}
+
+Program ReflectProgram(GLuint id)
+{
+	Program program;
+	program.id = id;
+	if (id == 0)
+		return program;
+
+	program.uniforms = ActiveVariables(id, true);
+	program.attributes = ActiveVariables(id, false);
+
+	const auto& names = UniformNames();
+	program.locations.assign(names.size(), -1);
+	for (const auto& uniform : program.uniforms)
+	{
+		auto index = UniformIndices().find(uniform.name);
+		if (index != UniformIndices().end())
+			program.locations[index->second] = uniform.location;
+	}
+	return program;
+}
+
+void Program::Set(const UniformName& name, GLint value) const
+{
+	GLint location = Location(name);
+	if (location >= 0)
+		glUniform1i(location, value);
+}
+
+void Program::Set(const UniformName& name, GLfloat value) const
+{
+	GLint location = Location(name);
+	if (location >= 0)
+		glUniform1f(location, value);
+}
+
+void Program::Set(const UniformName& name, const glm::ivec2& value) const
+{
+	GLint location = Location(name);
+	if (location >= 0)
+		glUniform2iv(location, 1, glm::value_ptr(value));
+}
+
+void Program::Set(const UniformName& name, const glm::vec2& value) const
+{
+	GLint location = Location(name);
+	if (location >= 0)
+		glUniform2fv(location, 1, glm::value_ptr(value));
+}
+
+void Program::Set(const UniformName& name, const glm::vec3& value) const
+{
+	GLint location = Location(name);
+	if (location >= 0)
+		glUniform3fv(location, 1, glm::value_ptr(value));
+}
+
+void Program::Set(const UniformName& name, const glm::vec4& value) const
+{
+	GLint location = Location(name);
+	if (location >= 0)
+		glUniform4fv(location, 1, glm::value_ptr(value));
+}
+
+void Program::Set(const UniformName& name, const glm::mat4& value) const
+{
+	GLint location = Location(name);
+	if (location >= 0)
+		glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+Program CreateProgramFromSources(const GLchar * vertex_shader_source, const GLchar * fragment_shader_source)
+{
+	GLuint shaders[] = {
+		CreateShaderFromSource(GL_VERTEX_SHADER, vertex_shader_source),
+		CreateShaderFromSource(GL_FRAGMENT_SHADER, fragment_shader_source),
+	};
+
+	return ReflectProgram(LinkProgram(shaders, 2));
+}
+
+Program CreateProgramFromSources(
+	const GLchar * vertex_shader_source,
+	const GLchar * tess_control_shader_source,
+	const GLchar * tess_evaluation_shader_source,
+	const GLchar * fragment_shader_source
+)
+{
+	GLuint shaders[] = {
+		CreateShaderFromSource(GL_VERTEX_SHADER, vertex_shader_source),
+		CreateShaderFromSource(GL_TESS_CONTROL_SHADER, tess_control_shader_source),
+		CreateShaderFromSource(GL_TESS_EVALUATION_SHADER, tess_evaluation_shader_source),
+		CreateShaderFromSource(GL_FRAGMENT_SHADER, fragment_shader_source),
+	};
+
+	return ReflectProgram(LinkProgram(shaders, 4));
+}
@@ -2,33 +2,371 @@
 
 #include <iostream>
 #include <vector>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
 
 #include "GLAD/glad.h"
 #include "GLM/glm.hpp"
+#include "GLM/gtc/type_precision.hpp"
 
 /* OpenGL Utility Structs */
 
+// How a VAO stores its vertices. Compressed is 12 bytes per vertex instead of
+// 24: positions as normalized 16-bit integers inside the mesh bounds and
+// normals as GL_INT_2_10_10_10_REV. Bind it with BindVAO so the vertex shader
+// gets the bounds to dequantize with.
+enum class VertexFormat
+{
+	Float,
+	Compressed,
+};
+
+// One attribute of a vertex. Attributes of the same stream share a buffer,
+// interleaved in the order they are listed, and each stream is a buffer of
+// its own; one stream per attribute is the separate layout.
+struct VertexAttribute
+{
+	GLuint location;
+	GLint component_count;
+	GLenum type;
+	GLboolean normalized;
+	GLuint stream;
+};
+
+struct VertexLayout
+{
+	std::vector<VertexAttribute> attributes;
+
+	GLuint StreamCount() const;
+
+	// Bytes per vertex in stream
+	GLsizei Stride(GLuint stream) const;
+
+	// Bytes an attribute takes in its stream, padded to 4 so every attribute
+	// stays aligned, and where it starts within the vertex
+	GLsizei AttributeSize(size_t attribute) const;
+	GLsizei AttributeOffset(size_t attribute) const;
+};
+
+// How the position and normal of a mesh VAO are laid out. Interleaved reads a
+// vertex from one place in one buffer; Separate keeps a buffer per attribute,
+// which is what Float meshes need to be generated straight into the buffers.
+enum class VertexStreams
+{
+	Interleaved,
+	Separate,
+};
+
+// The layout of a mesh VAO: the position at location 0 and the normal at
+// location 1, in the types of vertex_format
+VertexLayout MeshVertexLayout(VertexFormat vertex_format, VertexStreams vertex_streams = VertexStreams::Interleaved);
+
+typedef std::function<void(glm::vec3* positions, glm::vec3* normals, GLuint* indices)> VAOFill;
+
+struct GeometryArena;
+
+// Where a VAO suballocated from a GeometryArena lives in the arena's buffers.
+// The copies of the VAO share it, and the ranges go back to the arena with the
+// last of them; the arena moves it when it defragments.
+struct GeometryAllocation
+{
+	GeometryArena* arena;
+	GLsizei first_vertex;
+	GLsizei vertex_count;
+	GLsizei first_index;
+	GLsizei index_count;
+
+	~GeometryAllocation();
+};
+
 struct VAO
 {
 	GLuint id;
 
+	VertexFormat vertex_format;
+	VertexLayout vertex_layout;
 	GLsizei vertex_count;
-	GLuint position_buffer;
-	GLuint normals_buffer;
+	// One per stream of vertex_layout
+	std::vector<GLuint> vertex_buffers;
+
+	// position = a_position * position_scale + position_offset, identity for
+	// VertexFormat::Float
+	glm::vec3 position_scale;
+	glm::vec3 position_offset;
+
+	// GL_TRIANGLES or GL_TRIANGLE_STRIP; strips separate with the all-ones
+	// index of element_array_type as the primitive restart index
+	GLenum primitive_mode;
 
+	// GL_UNSIGNED_SHORT when every vertex fits in 16 bits, else GL_UNSIGNED_INT
 	GLsizei element_array_count;
+	GLenum element_array_type;
 	GLuint element_array_buffer;
 
+	// Set when id and the buffers are a GeometryArena's, shared with the other
+	// meshes in it; the mesh is drawn from the allocation's ranges with its
+	// first vertex as the base vertex
+	std::shared_ptr<GeometryAllocation> allocation;
+
 	VAO(
 		const std::vector<glm::vec3>& positions,
 		const std::vector<glm::vec3>& normals,
-		const std::vector<GLuint>& indices
+		const std::vector<GLuint>& indices,
+		VertexFormat vertex_format = VertexFormat::Float,
+		GLenum primitive_mode = GL_TRIANGLES,
+		VertexStreams vertex_streams = VertexStreams::Interleaved
+	);
+
+	// Any layout, with attributes such as tangents, texture coordinates or
+	// colors: attribute_data has an array per attribute of vertex_layout with
+	// an element of AttributeSize bytes per vertex. The vertex format is Float,
+	// as there are no bounds to dequantize positions with.
+	VAO(
+		const VertexLayout& vertex_layout,
+		GLsizei vertex_count,
+		const void* const* attribute_data,
+		const std::vector<GLuint>& indices,
+		GLenum primitive_mode = GL_TRIANGLES
+	);
+
+	// Allocates the buffers and calls fill with pointers to them mapped for
+	// writing (invalidated, so the driver never copies old contents back),
+	// letting a mesh be generated with no host-side copy. fill must only write
+	// every element, never read. If the buffers can't be mapped, or their
+	// contents are lost while mapped, fill runs again into host memory.
+	// Only Float vertices in Separate streams are generated in place; others,
+	// and 16-bit indices, are generated into host memory and packed or
+	// interleaved into the mapped buffers.
+	VAO(
+		GLsizei vertex_count,
+		GLsizei element_array_count,
+		const VAOFill& fill,
+		VertexFormat vertex_format = VertexFormat::Float,
+		GLenum primitive_mode = GL_TRIANGLES,
+		VertexStreams vertex_streams = VertexStreams::Interleaved
+	);
+
+	// Allocates the buffers without contents, for a mesh uploaded a range at a
+	// time with UploadVAO. Compressed positions are quantized to the cube of
+	// half-size position_bound around the origin, as the real bounds are only
+	// known once every range is in.
+	VAO(
+		GLsizei vertex_count,
+		GLsizei element_array_count,
+		float position_bound,
+		VertexFormat vertex_format = VertexFormat::Float,
+		GLenum primitive_mode = GL_TRIANGLES,
+		VertexStreams vertex_streams = VertexStreams::Interleaved
+	);
+
+	// Suballocates the mesh from arena, in its vertex format and layout, and
+	// fills it through host memory. A mesh the arena's index type can't
+	// address gets buffers of its own instead.
+	VAO(
+		GeometryArena& arena,
+		GLsizei vertex_count,
+		GLsizei element_array_count,
+		const VAOFill& fill,
+		GLenum primitive_mode = GL_TRIANGLES
+	);
+
+private:
+	void CreateBuffers(const void* const* attribute_data, const void* indices);
+	void FillBuffers(const VAOFill& fill, void* const* streams, void* indices);
+	void PackVertices(const glm::vec3* positions, const glm::vec3* normals, glm::i16vec4* packed_positions, GLuint* packed_normals);
+};
+
+struct GeometryArenaStatistics
+{
+	GLsizei vertex_capacity;
+	GLsizei index_capacity;
+	GLsizei used_vertices;
+	GLsizei used_indices;
+	// Live meshes, and the free ranges between them
+	size_t allocations;
+	size_t free_vertex_ranges;
+	size_t free_index_ranges;
+	// Times the buffers were enlarged or compacted
+	size_t grows;
+	size_t defragmentations;
+};
+
+// One vertex array over one set of vertex buffers and one index buffer that
+// static meshes are suballocated from, so drawing them changes no buffer
+// bindings and binds the same vertex array every time. Indices are relative
+// to each mesh's first vertex, which is its base vertex when drawn.
+//
+// Freed ranges are reused first fit and merge with their neighbours. When no
+// free range is large enough but the free space in total is, the arena
+// defragments; otherwise it grows. Both keep the buffer names, copying the
+// contents through a temporary buffer on the GPU.
+//
+// Every mesh has to be deleted before the arena, and the arena stays where it
+// was made, as its meshes point back to it.
+struct GeometryArena
+{
+	GLuint vertex_array;
+	VertexFormat vertex_format;
+	VertexStreams vertex_streams;
+	VertexLayout vertex_layout;
+	std::vector<GLuint> vertex_buffers;
+	GLenum element_array_type;
+	GLuint element_array_buffer;
+	GLsizei vertex_capacity;
+	GLsizei index_capacity;
+
+	GeometryArena(
+		VertexFormat vertex_format,
+		GLenum element_array_type,
+		GLsizei vertex_capacity,
+		GLsizei index_capacity,
+		VertexStreams vertex_streams = VertexStreams::Interleaved
 	);
+	GeometryArena(const GeometryArena&) = delete;
+	GeometryArena& operator=(const GeometryArena&) = delete;
+
+	// Moves every mesh to the start of the buffers, leaving the free space in
+	// one range at the end
+	void Defragment();
+
+	GeometryArenaStatistics Statistics() const;
+
+private:
+	friend struct VAO;
+	friend struct GeometryAllocation;
+
+	std::shared_ptr<GeometryAllocation> Allocate(GLsizei vertex_count, GLsizei index_count);
+	void Free(const GeometryAllocation& allocation);
+	void Grow(GLsizei vertex_capacity, GLsizei index_capacity);
+
+	// Offset to size of every free range
+	std::map<GLsizei, GLsizei> free_vertices;
+	std::map<GLsizei, GLsizei> free_indices;
+	std::vector<GeometryAllocation*> allocations;
+	size_t grows = 0;
+	size_t defragmentations = 0;
+};
+
+// A uniform name resolved once for every program. Each distinct name gets an
+// index when its first UniformName is constructed, and every Program fills a
+// table of locations by index when it links, so setting a uniform through a
+// UniformName is an array lookup. Make them with static storage duration, so
+// they exist before any program links.
+struct UniformName
+{
+	size_t index;
+
+	explicit UniformName(const char* name);
+};
+
+// An active uniform or attribute as the linker reports it. Array names lose
+// their "[0]"; uniforms in blocks and built-in inputs such as gl_VertexID
+// have location -1. Uniforms in blocks have the block's index and their
+// offset in it, the rest -1 for both.
+struct ProgramVariable
+{
+	std::string name;
+	GLint location;
+	GLenum type;
+	GLint size;
+	GLint block_index = -1;
+	GLint offset = -1;
+};
+
+// A linked program and what it reads, enumerated once at link time. id is 0
+// when compiling or linking failed.
+struct Program
+{
+	GLuint id = 0;
+	std::vector<ProgramVariable> uniforms;
+	std::vector<ProgramVariable> attributes;
+
+	// Location of name in this program, or -1 where it isn't an active uniform
+	GLint Location(const UniformName& name) const
+	{
+		return name.index < locations.size() ? locations[name.index] : -1;
+	}
+
+	// Set a uniform of the program in use, doing nothing where the program
+	// doesn't have it as a plain uniform
+	void Set(const UniformName& name, GLint value) const;
+	void Set(const UniformName& name, GLfloat value) const;
+	void Set(const UniformName& name, const glm::ivec2& value) const;
+	void Set(const UniformName& name, const glm::vec2& value) const;
+	void Set(const UniformName& name, const glm::vec3& value) const;
+	void Set(const UniformName& name, const glm::vec4& value) const;
+	void Set(const UniformName& name, const glm::mat4& value) const;
+
+private:
+	std::vector<GLint> locations;
+
+	friend Program ReflectProgram(GLuint id);
 };
 
 /* OpenGL Utility Functions */
 
+// GPU memory held by the VAO's buffers, in bytes
+GLsizeiptr VAOBufferSize(const VAO& vao);
+
+// Deletes the buffers and the vertex array. VAO is a plain handle that copies
+// freely, so nothing else does; call it once, with the context current.
+// A suballocated VAO only lets go of its allocation.
+void DeleteVAO(VAO& vao);
+
+// Deletes the arena's buffers and vertex array, once all its meshes are gone
+void DeleteGeometryArena(GeometryArena& arena);
+
+// A VAO shared between everything that draws the same mesh, see MeshRegistry.
+// The last handle to go calls DeleteVAO, so drop every handle while the
+// context is still current.
+typedef std::shared_ptr<VAO> SharedVAO;
+
+// Writes vertices [first_vertex, first_vertex + vertex_count) and indices
+// [first_index, first_index + index_count) of a VAO made without contents,
+// packing them to its formats and layout. Leaves the bound VAO alone.
+void UploadVAO(
+	const VAO& vao,
+	GLsizei first_vertex,
+	const glm::vec3* positions,
+	const glm::vec3* normals,
+	GLsizei vertex_count,
+	GLsizei first_index,
+	const GLuint* indices,
+	GLsizei index_count
+);
+
+// Binds the VAO and sets u_position_scale / u_position_offset on the program
+// in use, so the same vertex shader reads every VertexFormat. Programs that
+// take them from the DrawUniforms block get them from the draw's element.
+void BindVAO(const VAO& vao, const Program& program);
+
+// Draws every element of the bound VAO with its index type and primitive mode,
+// switching primitive restart on for strips and off otherwise. Suballocated
+// VAOs are drawn from their ranges with glDrawElementsBaseVertex.
+void DrawVAO(const VAO& vao);
+
+// Tessellation shaders need a GL 4.0 context, and the loader only has their
+// functions when the driver lists GL_ARB_tessellation_shader
+inline bool TessellationSupported()
+{
+	return GLVersion.major >= 4 && GLAD_GL_ARB_tessellation_shader;
+}
+
 GLuint CreateShaderFromSource(const GLenum& shader_type, const GLchar * source);
 
-GLuint CreateProgramFromSources(const GLchar * vertex_shader_source, const GLchar * fragment_shader_source);
+// Enumerates the active uniforms and attributes of a linked program
+Program ReflectProgram(GLuint id);
+
+Program CreateProgramFromSources(const GLchar * vertex_shader_source, const GLchar * fragment_shader_source);
+
+// With tessellation stages, which need a GL 4.0 context, see
+// TessellationSupported
+Program CreateProgramFromSources(
+	const GLchar * vertex_shader_source,
+	const GLchar * tess_control_shader_source,
+	const GLchar * tess_evaluation_shader_source,
+	const GLchar * fragment_shader_source
+);
 
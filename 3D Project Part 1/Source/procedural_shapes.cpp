@@ -0,0 +1,334 @@
+#include "procedural_shapes.h"
+
+#include <string>
+#include "mesh_generation.h"
+#include "mesh_lod.h"
+#include "uniform_blocks.h"
+
+/* Procedural Shapes */
+
+// Profiles are numbered as in ProceduralProfileNames. Grid points may lie
+// between the rows and columns, r being kept in [0, rotation segments).
+//
+// Normals follow BuildParametricRingVertices: where the tangents are parallel
+// the rows above and below are averaged. A vertex on the axis of an
+// unsquiggled shape is one the generators weld into a pole: it is left out of
+// the averages and points along the axis. u_transform and u_squiggle come
+// from the DrawUniforms block.
+static const char* ProceduralSurfaceSource = R"SURFACE(
+uniform int u_profile;
+uniform ivec2 u_segments;
+
+const float PI = 3.14159265358979;
+const float EPSILON = 1.1920929e-7;
+
+// The built-in profiles at t in [0, 1], with their derivative in t
+void Profile(float t, out vec2 p, out vec2 dp)
+{
+	if (u_profile == 0)
+	{
+		// ParametricHalfSquiggle
+		float a = (t - 0.5) * PI;
+		p = vec2(cos(a * 6) / 2 + 0.5, sin(a));
+		dp = PI * vec2(-3 * sin(a * 6), cos(a));
+	}
+	else if (u_profile == 1)
+	{
+		// ParametricHalfCircle
+		float a = (t - 0.5) * PI;
+		p = vec2(cos(a), sin(a));
+		dp = PI * vec2(-sin(a), cos(a));
+	}
+	else if (u_profile == 2)
+	{
+		// ParametricCircle
+		float a = (t - 0.5) * 2 * PI;
+		p = vec2(cos(a), sin(a)) * 0.3 + vec2(0.7, 0);
+		dp = 2 * PI * 0.3 * vec2(-sin(a), cos(a));
+	}
+	else
+	{
+		// ParametricSpikes
+		float a = (t - 0.5) * 2 * PI;
+		float k = 10;
+		p = vec2(cos(a) + sin(k * a) / k, sin(a) + cos(k * a) / k) * 0.3 + vec2(0.7, 0);
+		dp = 2 * PI * 0.3 * vec2(-sin(a) + cos(k * a), cos(a) - sin(k * a));
+	}
+}
+
+// p(v, r) = scale(r) * rotateY((x(v), y(v), 0), 2 PI r), the scale being the
+// squiggle of u_squiggle
+void SurfacePoint(float v, float r, out vec3 position, out vec3 tangent_r, out vec3 tangent_v, out bool pole)
+{
+	vec2 p, dp;
+	Profile(v / float(u_segments.x - 1), p, dp);
+
+	float angle = 2 * PI * r / float(u_segments.y);
+	float c = cos(angle);
+	float s = sin(angle);
+
+	float wave = u_squiggle.x * angle + u_squiggle.z;
+	float scale = u_squiggle.w * (1 + u_squiggle.y * sin(wave));
+	float scale_derivative = u_squiggle.w * u_squiggle.y * u_squiggle.x * cos(wave) * 2 * PI;
+
+	vec3 unscaled = vec3(p.x * c, p.y, -p.x * s);
+	position = scale * unscaled;
+	tangent_v = vec3(dp.x * c, dp.y, -dp.x * s);
+	tangent_r = scale_derivative * unscaled + scale * 2 * PI * vec3(-p.x * s, 0, -p.x * c);
+	pole = u_squiggle.y == 0 && abs(p.x) <= 16 * EPSILON * max(abs(p.x), abs(p.y));
+}
+
+vec3 Rescale(vec3 tangent)
+{
+	float extent = max(max(abs(tangent.x), abs(tangent.y)), abs(tangent.z));
+	return extent > 0 ? tangent / extent : tangent;
+}
+
+// Unit normal, or zero where the tangents are (nearly) parallel
+vec3 UnitNormal(vec3 tangent_r, vec3 tangent_v)
+{
+	tangent_r = Rescale(tangent_r);
+	tangent_v = Rescale(tangent_v);
+	vec3 normal = cross(tangent_r, tangent_v);
+	float tolerance = 16 * EPSILON * length(tangent_r) * length(tangent_v);
+	return length(normal) > tolerance ? normalize(normal) : vec3(0);
+}
+
+// Sum of the normals step rows above and below
+vec3 NeighbourNormal(float v, float r, float step)
+{
+	vec3 normal = vec3(0);
+	vec3 position, tangent_r, tangent_v;
+	bool pole;
+
+	if (v > 0)
+	{
+		SurfacePoint(max(v - step, 0), r, position, tangent_r, tangent_v, pole);
+		normal += pole ? vec3(0) : UnitNormal(tangent_r, tangent_v);
+	}
+	if (v < u_segments.x - 1)
+	{
+		SurfacePoint(min(v + step, u_segments.x - 1), r, position, tangent_r, tangent_v, pole);
+		normal += pole ? vec3(0) : UnitNormal(tangent_r, tangent_v);
+	}
+	return normal;
+}
+
+// The unit normal at (v, r), falling back to the rows step away
+vec3 SurfaceNormal(float v, float r, float step, vec3 tangent_r, vec3 tangent_v, bool pole)
+{
+	vec3 normal = pole ? vec3(0) : UnitNormal(tangent_r, tangent_v);
+	if (normal == vec3(0))
+	{
+		normal = NeighbourNormal(v, r, step);
+		if (pole)
+			normal.xz = vec2(0);
+		normal = normal == vec3(0) ? vec3(0, 1, 0) : normalize(normal);
+	}
+	return normal;
+}
+)SURFACE";
+
+// Quads go column by column as in the meshes, (v, r) being their corner
+// nearest the origin of the grid, and every quad is the two triangles of
+// BuildParametricListIndices
+static const std::string ProceduralShapeVertexSource = std::string(R"VERTEX(
+#version 330 core
+)VERTEX") + UniformBlocksSource + ProceduralSurfaceSource + R"VERTEX(
+out vec3 vertex_position;
+out vec3 vertex_normal;
+
+const ivec2 corners[6] = ivec2[6](
+	ivec2(1, 0), ivec2(0, 1), ivec2(0, 0),
+	ivec2(1, 0), ivec2(1, 1), ivec2(0, 1)
+);
+
+void main()
+{
+	int quad = gl_VertexID / 6;
+	ivec2 corner = corners[gl_VertexID % 6];
+	int v = quad % (u_segments.x - 1) + corner.x;
+	int r = (quad / (u_segments.x - 1) + corner.y) % u_segments.y;
+
+	vec3 position, tangent_r, tangent_v;
+	bool pole;
+	SurfacePoint(float(v), float(r), position, tangent_r, tangent_v, pole);
+	vec3 normal = SurfaceNormal(float(v), float(r), 1, tangent_r, tangent_v, pole);
+
+	gl_Position = u_transform * vec4(position, 1);
+	vertex_normal = vec3(u_transform * vec4(normal, 0));
+	vertex_position = vec3(gl_Position);
+}
+)VERTEX";
+
+const GLchar* ProceduralShapeVertexShader = ProceduralShapeVertexSource.c_str();
+
+// Indexed by the u_profile of the GLSL version
+static const char* ProceduralProfileNames[] = { "half_squiggle", "half_circle", "circle", "spikes" };
+
+bool CreateProceduralShape(
+	ProceduralShape& shape,
+	glm::dvec2(*parametric_line)(double),
+	int vertical_segments,
+	int rotation_segments
+)
+{
+	shape = ProceduralShape();
+
+	auto name = FindParametricLineName(parametric_line);
+	if (!name)
+		return false;
+
+	for (GLint profile = 0; profile < GLint(sizeof(ProceduralProfileNames) / sizeof(*ProceduralProfileNames)); ++profile)
+		if (std::string(name) == ProceduralProfileNames[profile])
+			shape.profile = profile;
+	if (shape.profile < 0)
+		return false;
+
+	glGenVertexArrays(1, &shape.vertex_array);
+	shape.vertical_segments = vertical_segments;
+	shape.rotation_segments = rotation_segments;
+	return true;
+}
+
+void DeleteProceduralShape(ProceduralShape& shape)
+{
+	glDeleteVertexArrays(1, &shape.vertex_array);
+	shape = ProceduralShape();
+}
+
+static const UniformName UniformProfile("u_profile");
+static const UniformName UniformSegments("u_segments");
+static const UniformName UniformViewport("u_viewport");
+static const UniformName UniformEdgePixels("u_edge_pixels");
+
+GLsizei DrawProceduralShape(const ProceduralShape& shape, const Program& program)
+{
+	program.Set(UniformProfile, shape.profile);
+	program.Set(UniformSegments, glm::ivec2(shape.vertical_segments, shape.rotation_segments));
+
+	GLsizei quad_count = (shape.vertical_segments - 1) * shape.rotation_segments;
+	glBindVertexArray(shape.vertex_array);
+	glDrawArrays(GL_TRIANGLES, 0, quad_count * 6);
+
+	return quad_count * 2;
+}
+
+/* Tessellated Shapes */
+
+// Every quad of the grid is a patch of one vertex, which only passes on which
+// quad it is
+const GLchar* TessellatedShapeVertexShader = R"VERTEX(
+#version 400 core
+
+out int vertex_quad;
+
+void main()
+{
+	vertex_quad = gl_VertexID;
+}
+)VERTEX";
+
+// An edge is split into pieces about u_edge_pixels long on screen, measured
+// along the surface so a wave the edge spans still counts. Each edge is
+// measured from its lower end whichever patch it belongs to, so both patches
+// on it agree exactly and the tessellation has no cracks.
+static const std::string TessellatedShapeControlSource = std::string(R"CONTROL(
+#version 400 core
+)CONTROL") + UniformBlocksSource + ProceduralSurfaceSource + R"CONTROL(
+layout(vertices = 1) out;
+
+uniform vec2 u_viewport;
+uniform float u_edge_pixels;
+
+in int vertex_quad[];
+patch out vec2 patch_origin;
+
+const int EDGE_SAMPLES = 8;
+
+vec2 ScreenPoint(vec2 grid)
+{
+	vec3 position, tangent_r, tangent_v;
+	bool pole;
+	SurfacePoint(grid.x, grid.y < u_segments.y ? grid.y : grid.y - u_segments.y, position, tangent_r, tangent_v, pole);
+
+	vec4 clip = u_transform * vec4(position, 1);
+	return clip.xy / clip.w * u_viewport / 2;
+}
+
+float EdgeLevel(vec2 start, vec2 direction)
+{
+	float pixels = 0;
+	vec2 previous = ScreenPoint(start);
+	for (int i = 1; i <= EDGE_SAMPLES; ++i)
+	{
+		vec2 point = ScreenPoint(start + direction * (float(i) / EDGE_SAMPLES));
+		pixels += length(point - previous);
+		previous = point;
+	}
+	return clamp(pixels / u_edge_pixels, 1, float(gl_MaxTessGenLevel));
+}
+
+void main()
+{
+	int rows = u_segments.x - 1;
+	vec2 origin = vec2(vertex_quad[0] % rows, vertex_quad[0] / rows);
+	patch_origin = origin;
+
+	// Outer levels go u = 0, v = 0, u = 1, v = 1 with u along the profile
+	gl_TessLevelOuter[0] = EdgeLevel(origin, vec2(0, 1));
+	gl_TessLevelOuter[1] = EdgeLevel(origin, vec2(1, 0));
+	gl_TessLevelOuter[2] = EdgeLevel(origin + vec2(1, 0), vec2(0, 1));
+	gl_TessLevelOuter[3] = EdgeLevel(origin + vec2(0, 1), vec2(1, 0));
+	gl_TessLevelInner[0] = max(gl_TessLevelOuter[1], gl_TessLevelOuter[3]);
+	gl_TessLevelInner[1] = max(gl_TessLevelOuter[0], gl_TessLevelOuter[2]);
+}
+)CONTROL";
+
+// Evaluates the surface at each generated point. The normal falls back to
+// points a 64th of a patch away, finer than any tessellation level reaches.
+static const std::string TessellatedShapeEvaluationSource = std::string(R"EVALUATION(
+#version 400 core
+)EVALUATION") + UniformBlocksSource + ProceduralSurfaceSource + R"EVALUATION(
+layout(quads, fractional_even_spacing, ccw) in;
+
+patch in vec2 patch_origin;
+
+out vec3 vertex_position;
+out vec3 vertex_normal;
+
+void main()
+{
+	float v = patch_origin.x + gl_TessCoord.x;
+	float r = patch_origin.y + gl_TessCoord.y;
+	if (r >= u_segments.y)
+		r -= u_segments.y;
+
+	vec3 position, tangent_r, tangent_v;
+	bool pole;
+	SurfacePoint(v, r, position, tangent_r, tangent_v, pole);
+	vec3 normal = SurfaceNormal(v, r, 1.0 / 64, tangent_r, tangent_v, pole);
+
+	gl_Position = u_transform * vec4(position, 1);
+	vertex_normal = vec3(u_transform * vec4(normal, 0));
+	vertex_position = vec3(gl_Position);
+}
+)EVALUATION";
+
+const GLchar* TessellatedShapeControlShader = TessellatedShapeControlSource.c_str();
+const GLchar* TessellatedShapeEvaluationShader = TessellatedShapeEvaluationSource.c_str();
+
+GLsizei DrawTessellatedShape(const ProceduralShape& shape, const Program& program, glm::ivec2 screen_dimensions)
+{
+	program.Set(UniformProfile, shape.profile);
+	program.Set(UniformSegments, glm::ivec2(shape.vertical_segments, shape.rotation_segments));
+	program.Set(UniformViewport, glm::vec2(screen_dimensions));
+	program.Set(UniformEdgePixels, MeshLODEdgePixels);
+
+	GLsizei patch_count = (shape.vertical_segments - 1) * shape.rotation_segments;
+	glBindVertexArray(shape.vertex_array);
+	glPatchParameteri(GL_PATCH_VERTICES, 1);
+	glDrawArrays(GL_PATCHES, 0, patch_count);
+
+	return patch_count;
+}
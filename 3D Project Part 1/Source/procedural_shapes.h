@@ -0,0 +1,65 @@
+#pragma once
+
+#include "GLM/glm.hpp"
+#include "GLAD/glad.h"
+#include "opengl_utilities.h"
+
+/* Procedural Shapes */
+
+// Surfaces of revolution drawn with no vertex buffers. The vertex shader finds
+// its grid point and triangle corner from gl_VertexID and evaluates a GLSL
+// version of the built-in profile with its analytic derivative, so a shape
+// takes no vertex memory and changes resolution between draws for free.
+//
+// Make the program from ProceduralShapeVertexShader and any of the mesh
+// fragment shaders: it has the same outputs as the mesh vertex shader and
+// reads u_transform and u_squiggle from the same DrawUniforms block. The grid
+// and the triangles are those of a TriangleList mesh from
+// GenerateParametricShapeFrom2D, with the squiggle given by u_squiggle
+// instead of baked in. Poles aren't welded; their zero-area triangles are
+// left to the rasterizer.
+extern const GLchar* ProceduralShapeVertexShader;
+
+struct ProceduralShape
+{
+	// Empty, core profiles draw nothing without a vertex array bound
+	GLuint vertex_array = 0;
+
+	// Built-in profile number the shader evaluates
+	GLint profile = -1;
+	GLint vertical_segments = 0;
+	GLint rotation_segments = 0;
+};
+
+// False, leaving shape empty, for a profile that has no GLSL version
+bool CreateProceduralShape(
+	ProceduralShape& shape,
+	glm::dvec2(*parametric_line)(double),
+	int vertical_segments,
+	int rotation_segments
+);
+
+void DeleteProceduralShape(ProceduralShape& shape);
+
+// Sets the shape's uniforms on program, which must be in use, and draws it.
+// Returns the number of triangles drawn.
+GLsizei DrawProceduralShape(const ProceduralShape& shape, const Program& program);
+
+/* Tessellated Shapes */
+
+// The same surfaces refined on the GPU. The grid of a ProceduralShape is only
+// the coarse patch grid here: the control shader splits every patch edge into
+// pieces about MeshLODEdgePixels long on screen and the evaluation shader
+// evaluates the profile at each new point, so close shapes get detail and
+// distant ones stay cheap without anything being generated again.
+//
+// Make the program from the three shaders below and any of the mesh fragment
+// shaders, and only where TessellationSupported; GL 3.3 contexts draw the
+// CPU-generated meshes instead.
+extern const GLchar* TessellatedShapeVertexShader;
+extern const GLchar* TessellatedShapeControlShader;
+extern const GLchar* TessellatedShapeEvaluationShader;
+
+// As DrawProceduralShape, for the screen the transform maps to. Returns the
+// number of patches drawn; how many triangles they make is up to the GPU.
+GLsizei DrawTessellatedShape(const ProceduralShape& shape, const Program& program, glm::ivec2 screen_dimensions);
@@ -0,0 +1,379 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SIMD_MATH_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SIMD_MATH_SSE2 1
+#endif
+
+/* Lane Types */
+
+// Every lane type exposes the same operations, so kernels written as templates
+// over the lane type compile to AVX2, SSE2 or plain scalar code. The scalar
+// types are used for loop tails and on targets without SSE2, with the same
+// polynomials as the vector versions so all lanes agree.
+
+struct ScalarDouble
+{
+	typedef double Scalar;
+	static const int width = 1;
+	double v;
+
+	static ScalarDouble Broadcast(double x) { return { x }; }
+	static ScalarDouble Load(const double* p) { return { *p }; }
+};
+
+inline ScalarDouble operator+(ScalarDouble a, ScalarDouble b) { return { a.v + b.v }; }
+inline ScalarDouble operator-(ScalarDouble a, ScalarDouble b) { return { a.v - b.v }; }
+inline ScalarDouble operator*(ScalarDouble a, ScalarDouble b) { return { a.v * b.v }; }
+
+// Writes x0 y0 x1 y1 ... to out
+inline void StoreInterleaved(double* out, ScalarDouble x, ScalarDouble y)
+{
+	out[0] = x.v;
+	out[1] = y.v;
+}
+
+struct ScalarFloat
+{
+	typedef float Scalar;
+	static const int width = 1;
+	float v;
+
+	static ScalarFloat Broadcast(double x) { return { float(x) }; }
+	static ScalarFloat Load(const float* p) { return { *p }; }
+};
+
+inline ScalarFloat operator+(ScalarFloat a, ScalarFloat b) { return { a.v + b.v }; }
+inline ScalarFloat operator-(ScalarFloat a, ScalarFloat b) { return { a.v - b.v }; }
+inline ScalarFloat operator*(ScalarFloat a, ScalarFloat b) { return { a.v * b.v }; }
+
+inline void StoreInterleaved(float* out, ScalarFloat x, ScalarFloat y)
+{
+	out[0] = x.v;
+	out[1] = y.v;
+}
+
+#if SIMD_MATH_AVX2
+struct SimdDouble
+{
+	typedef double Scalar;
+	static const int width = 4;
+	__m256d v;
+
+	static SimdDouble Broadcast(double x) { return { _mm256_set1_pd(x) }; }
+	static SimdDouble Load(const double* p) { return { _mm256_loadu_pd(p) }; }
+};
+
+inline SimdDouble operator+(SimdDouble a, SimdDouble b) { return { _mm256_add_pd(a.v, b.v) }; }
+inline SimdDouble operator-(SimdDouble a, SimdDouble b) { return { _mm256_sub_pd(a.v, b.v) }; }
+inline SimdDouble operator*(SimdDouble a, SimdDouble b) { return { _mm256_mul_pd(a.v, b.v) }; }
+
+inline void StoreInterleaved(double* out, SimdDouble x, SimdDouble y)
+{
+	__m256d lo = _mm256_unpacklo_pd(x.v, y.v); // x0 y0 x2 y2
+	__m256d hi = _mm256_unpackhi_pd(x.v, y.v); // x1 y1 x3 y3
+	_mm256_storeu_pd(out, _mm256_permute2f128_pd(lo, hi, 0x20));
+	_mm256_storeu_pd(out + 4, _mm256_permute2f128_pd(lo, hi, 0x31));
+}
+
+struct SimdFloat
+{
+	typedef float Scalar;
+	static const int width = 8;
+	__m256 v;
+
+	static SimdFloat Broadcast(double x) { return { _mm256_set1_ps(float(x)) }; }
+	static SimdFloat Load(const float* p) { return { _mm256_loadu_ps(p) }; }
+};
+
+inline SimdFloat operator+(SimdFloat a, SimdFloat b) { return { _mm256_add_ps(a.v, b.v) }; }
+inline SimdFloat operator-(SimdFloat a, SimdFloat b) { return { _mm256_sub_ps(a.v, b.v) }; }
+inline SimdFloat operator*(SimdFloat a, SimdFloat b) { return { _mm256_mul_ps(a.v, b.v) }; }
+
+inline void StoreInterleaved(float* out, SimdFloat x, SimdFloat y)
+{
+	__m256 lo = _mm256_unpacklo_ps(x.v, y.v); // x0 y0 x1 y1 x4 y4 x5 y5
+	__m256 hi = _mm256_unpackhi_ps(x.v, y.v); // x2 y2 x3 y3 x6 y6 x7 y7
+	_mm256_storeu_ps(out, _mm256_permute2f128_ps(lo, hi, 0x20));
+	_mm256_storeu_ps(out + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+}
+#elif SIMD_MATH_SSE2
+struct SimdDouble
+{
+	typedef double Scalar;
+	static const int width = 2;
+	__m128d v;
+
+	static SimdDouble Broadcast(double x) { return { _mm_set1_pd(x) }; }
+	static SimdDouble Load(const double* p) { return { _mm_loadu_pd(p) }; }
+};
+
+inline SimdDouble operator+(SimdDouble a, SimdDouble b) { return { _mm_add_pd(a.v, b.v) }; }
+inline SimdDouble operator-(SimdDouble a, SimdDouble b) { return { _mm_sub_pd(a.v, b.v) }; }
+inline SimdDouble operator*(SimdDouble a, SimdDouble b) { return { _mm_mul_pd(a.v, b.v) }; }
+
+inline void StoreInterleaved(double* out, SimdDouble x, SimdDouble y)
+{
+	_mm_storeu_pd(out, _mm_unpacklo_pd(x.v, y.v));
+	_mm_storeu_pd(out + 2, _mm_unpackhi_pd(x.v, y.v));
+}
+
+struct SimdFloat
+{
+	typedef float Scalar;
+	static const int width = 4;
+	__m128 v;
+
+	static SimdFloat Broadcast(double x) { return { _mm_set1_ps(float(x)) }; }
+	static SimdFloat Load(const float* p) { return { _mm_loadu_ps(p) }; }
+};
+
+inline SimdFloat operator+(SimdFloat a, SimdFloat b) { return { _mm_add_ps(a.v, b.v) }; }
+inline SimdFloat operator-(SimdFloat a, SimdFloat b) { return { _mm_sub_ps(a.v, b.v) }; }
+inline SimdFloat operator*(SimdFloat a, SimdFloat b) { return { _mm_mul_ps(a.v, b.v) }; }
+
+inline void StoreInterleaved(float* out, SimdFloat x, SimdFloat y)
+{
+	_mm_storeu_ps(out, _mm_unpacklo_ps(x.v, y.v));
+	_mm_storeu_ps(out + 4, _mm_unpackhi_ps(x.v, y.v));
+}
+#else
+typedef ScalarDouble SimdDouble;
+typedef ScalarFloat SimdFloat;
+#endif
+
+// Widest and single-lane types for a scalar type
+template <typename T>
+struct SimdLanes;
+
+template <>
+struct SimdLanes<double>
+{
+	typedef SimdDouble Vector;
+	typedef ScalarDouble Single;
+};
+
+template <>
+struct SimdLanes<float>
+{
+	typedef SimdFloat Vector;
+	typedef ScalarFloat Single;
+};
+
+/* Sine and Cosine */
+
+// Reduced-range kernels for |r| <= pi/4, accurate to about 1 ulp: fdlibm
+// __kernel_sin/__kernel_cos coefficients for double, cephes sinf/cosf for
+// float.
+template <typename Lanes>
+inline Lanes SinKernel(Lanes r, double)
+{
+	Lanes z = r * r;
+	Lanes p = Lanes::Broadcast(1.58969099521155010221e-10);
+	p = p * z + Lanes::Broadcast(-2.50507602534068634195e-08);
+	p = p * z + Lanes::Broadcast(2.75573137070700676789e-06);
+	p = p * z + Lanes::Broadcast(-1.98412698298579493134e-04);
+	p = p * z + Lanes::Broadcast(8.33333333332248946124e-03);
+	p = p * z + Lanes::Broadcast(-1.66666666666666324348e-01);
+	return r + r * z * p;
+}
+
+template <typename Lanes>
+inline Lanes CosKernel(Lanes r, double)
+{
+	Lanes z = r * r;
+	Lanes p = Lanes::Broadcast(-1.13596475577881948265e-11);
+	p = p * z + Lanes::Broadcast(2.08757232129817482790e-09);
+	p = p * z + Lanes::Broadcast(-2.75573143513906633035e-07);
+	p = p * z + Lanes::Broadcast(2.48015872894767294178e-05);
+	p = p * z + Lanes::Broadcast(-1.38888888888741095749e-03);
+	p = p * z + Lanes::Broadcast(4.16666666666666019037e-02);
+	return Lanes::Broadcast(1.) - Lanes::Broadcast(0.5) * z + z * z * p;
+}
+
+template <typename Lanes>
+inline Lanes SinKernel(Lanes r, float)
+{
+	Lanes z = r * r;
+	Lanes p = Lanes::Broadcast(-1.9515295891e-4);
+	p = p * z + Lanes::Broadcast(8.3321608736e-3);
+	p = p * z + Lanes::Broadcast(-1.6666654611e-1);
+	return r + r * z * p;
+}
+
+template <typename Lanes>
+inline Lanes CosKernel(Lanes r, float)
+{
+	Lanes z = r * r;
+	Lanes p = Lanes::Broadcast(2.443315711809948e-5);
+	p = p * z + Lanes::Broadcast(-1.388731625493765e-3);
+	p = p * z + Lanes::Broadcast(4.166664568298827e-2);
+	return Lanes::Broadcast(1.) - Lanes::Broadcast(0.5) * z + z * z * p;
+}
+
+template <typename Lanes>
+inline Lanes SinKernel(Lanes r)
+{
+	return SinKernel(r, typename Lanes::Scalar());
+}
+
+template <typename Lanes>
+inline Lanes CosKernel(Lanes r)
+{
+	return CosKernel(r, typename Lanes::Scalar());
+}
+
+// x = q * pi/2 + r with |r| <= pi/4, pi/2 split in three parts so the
+// reduction stays exact over the parameter ranges the generators use
+// (|q| < 2^20 for double, |q| < 2^8 for float).
+template <typename Lanes>
+inline Lanes ReduceHalfPi(Lanes x, Lanes q, double)
+{
+	x = x - q * Lanes::Broadcast(1.57079632673412561417e+00);
+	x = x - q * Lanes::Broadcast(6.07710050630396597660e-11);
+	x = x - q * Lanes::Broadcast(2.02226624871116645580e-21);
+	return x;
+}
+
+template <typename Lanes>
+inline Lanes ReduceHalfPi(Lanes x, Lanes q, float)
+{
+	x = x - q * Lanes::Broadcast(1.5703125);
+	x = x - q * Lanes::Broadcast(4.837512969970703125e-4);
+	x = x - q * Lanes::Broadcast(7.54978995489188216e-8);
+	return x;
+}
+
+template <typename Lanes>
+inline Lanes ReduceHalfPi(Lanes x, Lanes q)
+{
+	return ReduceHalfPi(x, q, typename Lanes::Scalar());
+}
+
+inline void SinCos(ScalarDouble x, ScalarDouble& s, ScalarDouble& c)
+{
+	double q = std::nearbyint(x.v * 6.36619772367581382433e-01);
+	ScalarDouble r = ReduceHalfPi(x, ScalarDouble::Broadcast(q));
+	double sr = SinKernel(r).v;
+	double cr = CosKernel(r).v;
+
+	switch (int(q) & 3)
+	{
+	case 0: s.v = sr; c.v = cr; break;
+	case 1: s.v = cr; c.v = -sr; break;
+	case 2: s.v = -sr; c.v = -cr; break;
+	default: s.v = -cr; c.v = sr; break;
+	}
+}
+
+inline void SinCos(ScalarFloat x, ScalarFloat& s, ScalarFloat& c)
+{
+	float q = std::nearbyint(x.v * 6.36619772367581382433e-01f);
+	ScalarFloat r = ReduceHalfPi(x, ScalarFloat::Broadcast(q));
+	float sr = SinKernel(r).v;
+	float cr = CosKernel(r).v;
+
+	switch (int(q) & 3)
+	{
+	case 0: s.v = sr; c.v = cr; break;
+	case 1: s.v = cr; c.v = -sr; break;
+	case 2: s.v = -sr; c.v = -cr; break;
+	default: s.v = -cr; c.v = sr; break;
+	}
+}
+
+#if SIMD_MATH_AVX2
+inline void SinCos(SimdDouble x, SimdDouble& s, SimdDouble& c)
+{
+	// Adding 1.5 * 2^52 rounds to the nearest integer and leaves it in the
+	// low mantissa bits, which gives the quadrant without a conversion.
+	const __m256d magic = _mm256_set1_pd(6755399441055744.0);
+	__m256d shifted = _mm256_add_pd(_mm256_mul_pd(x.v, _mm256_set1_pd(6.36619772367581382433e-01)), magic);
+	__m256i quadrant = _mm256_castpd_si256(shifted);
+	SimdDouble q = { _mm256_sub_pd(shifted, magic) };
+
+	SimdDouble r = ReduceHalfPi(x, q);
+	__m256d sr = SinKernel(r).v;
+	__m256d cr = CosKernel(r).v;
+
+	__m256i one = _mm256_set1_epi64x(1);
+	__m256d swap = _mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(quadrant, one), one));
+	__m256d sin_sign = _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_and_si256(quadrant, _mm256_set1_epi64x(2)), 62));
+	__m256d cos_sign = _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_and_si256(_mm256_add_epi64(quadrant, one), _mm256_set1_epi64x(2)), 62));
+
+	s.v = _mm256_xor_pd(_mm256_blendv_pd(sr, cr, swap), sin_sign);
+	c.v = _mm256_xor_pd(_mm256_blendv_pd(cr, sr, swap), cos_sign);
+}
+
+inline void SinCos(SimdFloat x, SimdFloat& s, SimdFloat& c)
+{
+	// Same trick with 1.5 * 2^23 for single precision
+	const __m256 magic = _mm256_set1_ps(12582912.0f);
+	__m256 shifted = _mm256_add_ps(_mm256_mul_ps(x.v, _mm256_set1_ps(6.36619772367581382433e-01f)), magic);
+	__m256i quadrant = _mm256_castps_si256(shifted);
+	SimdFloat q = { _mm256_sub_ps(shifted, magic) };
+
+	SimdFloat r = ReduceHalfPi(x, q);
+	__m256 sr = SinKernel(r).v;
+	__m256 cr = CosKernel(r).v;
+
+	__m256i one = _mm256_set1_epi32(1);
+	__m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(quadrant, one), one));
+	__m256 sin_sign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(quadrant, _mm256_set1_epi32(2)), 30));
+	__m256 cos_sign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(quadrant, one), _mm256_set1_epi32(2)), 30));
+
+	s.v = _mm256_xor_ps(_mm256_blendv_ps(sr, cr, swap), sin_sign);
+	c.v = _mm256_xor_ps(_mm256_blendv_ps(cr, sr, swap), cos_sign);
+}
+#elif SIMD_MATH_SSE2
+inline void SinCos(SimdDouble x, SimdDouble& s, SimdDouble& c)
+{
+	// Adding 1.5 * 2^52 rounds to the nearest integer and leaves it in the
+	// low mantissa bits, which gives the quadrant without a conversion.
+	const __m128d magic = _mm_set1_pd(6755399441055744.0);
+	__m128d shifted = _mm_add_pd(_mm_mul_pd(x.v, _mm_set1_pd(6.36619772367581382433e-01)), magic);
+	__m128i quadrant = _mm_castpd_si128(shifted);
+	SimdDouble q = { _mm_sub_pd(shifted, magic) };
+
+	SimdDouble r = ReduceHalfPi(x, q);
+	__m128d sr = SinKernel(r).v;
+	__m128d cr = CosKernel(r).v;
+
+	// SSE2 has no 64-bit compare, so spread bit 0 of each lane over the lane
+	__m128i odd = _mm_shuffle_epi32(_mm_slli_epi64(quadrant, 63), _MM_SHUFFLE(3, 3, 1, 1));
+	__m128d swap = _mm_castsi128_pd(_mm_srai_epi32(odd, 31));
+	__m128i two = _mm_set_epi32(0, 2, 0, 2);
+	__m128d sin_sign = _mm_castsi128_pd(_mm_slli_epi64(_mm_and_si128(quadrant, two), 62));
+	__m128d cos_sign = _mm_castsi128_pd(_mm_slli_epi64(_mm_and_si128(_mm_add_epi64(quadrant, _mm_set_epi32(0, 1, 0, 1)), two), 62));
+
+	s.v = _mm_xor_pd(_mm_or_pd(_mm_and_pd(swap, cr), _mm_andnot_pd(swap, sr)), sin_sign);
+	c.v = _mm_xor_pd(_mm_or_pd(_mm_and_pd(swap, sr), _mm_andnot_pd(swap, cr)), cos_sign);
+}
+
+inline void SinCos(SimdFloat x, SimdFloat& s, SimdFloat& c)
+{
+	// Same trick with 1.5 * 2^23 for single precision
+	const __m128 magic = _mm_set1_ps(12582912.0f);
+	__m128 shifted = _mm_add_ps(_mm_mul_ps(x.v, _mm_set1_ps(6.36619772367581382433e-01f)), magic);
+	__m128i quadrant = _mm_castps_si128(shifted);
+	SimdFloat q = { _mm_sub_ps(shifted, magic) };
+
+	SimdFloat r = ReduceHalfPi(x, q);
+	__m128 sr = SinKernel(r).v;
+	__m128 cr = CosKernel(r).v;
+
+	__m128i one = _mm_set1_epi32(1);
+	__m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quadrant, one), one));
+	__m128 sin_sign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(quadrant, _mm_set1_epi32(2)), 30));
+	__m128 cos_sign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(quadrant, one), _mm_set1_epi32(2)), 30));
+
+	s.v = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, cr), _mm_andnot_ps(swap, sr)), sin_sign);
+	c.v = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, sr), _mm_andnot_ps(swap, cr)), cos_sign);
+}
+#endif
@@ -0,0 +1,187 @@
+#include "stream_buffer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+/* Stream Buffer */
+
+// The copy target keeps the buffer out of the bindings the draws use
+StreamBuffer::StreamBuffer(GLsizeiptr frame_size, bool persistent)
+{
+	this->frame_size = (frame_size + StreamBufferRegionAlignment - 1) / StreamBufferRegionAlignment * StreamBufferRegionAlignment;
+	frame_size = this->frame_size;
+	this->persistent = persistent && GLAD_GL_ARB_buffer_storage && glBufferStorage;
+
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+
+	if (this->persistent)
+	{
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_COPY_WRITE_BUFFER, StreamBufferFrames * frame_size, NULL, flags);
+		mapping = static_cast<char *>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, StreamBufferFrames * frame_size, flags));
+
+		if (mapping == NULL)
+		{
+			std::cout << "Warning: Persistent mapping failed, streaming by orphaning" << std::endl;
+			glDeleteBuffers(1, &buffer);
+			glGenBuffers(1, &buffer);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+			this->persistent = false;
+		}
+	}
+
+	if (!this->persistent)
+	{
+		glBufferData(GL_COPY_WRITE_BUFFER, frame_size, NULL, GL_STREAM_DRAW);
+		staging.resize(frame_size);
+	}
+}
+
+// A region's fence went in after the last draw that read it, StreamBufferFrames
+// frames ago. Polling first tells a stall from a fence that had already passed.
+void StreamBuffer::BeginFrame()
+{
+	frame = (frame + 1) % StreamBufferFrames;
+	head = 0;
+	flushed = 0;
+	rewritten_begin = rewritten_end = 0;
+
+	if (!persistent)
+	{
+		// The driver hands the old store to the draws still reading it
+		frame_offset = 0;
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glBufferData(GL_COPY_WRITE_BUFFER, frame_size, NULL, GL_STREAM_DRAW);
+		return;
+	}
+
+	frame_offset = frame * frame_size;
+
+	GLsync& fence = fences[frame];
+	if (fence == NULL)
+		return;
+
+	GLenum status = glClientWaitSync(fence, 0, 0);
+	if (status == GL_TIMEOUT_EXPIRED)
+	{
+		statistics.stalls++;
+		do
+		{
+			status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+		} while (status == GL_TIMEOUT_EXPIRED);
+	}
+	if (status == GL_WAIT_FAILED)
+		std::cout << "Warning: Waiting on a stream buffer fence failed" << std::endl;
+
+	glDeleteSync(fence);
+	fence = NULL;
+}
+
+StreamAllocation StreamBuffer::Allocate(GLsizeiptr size, GLsizeiptr alignment)
+{
+	StreamAllocation allocation = { nullptr, 0, size };
+
+	GLsizeiptr start = (head + alignment - 1) & ~(alignment - 1);
+	if (start + size > frame_size)
+	{
+		statistics.overflows++;
+		return allocation;
+	}
+
+	head = start + size;
+	allocation.offset = frame_offset + start;
+	allocation.data = (persistent ? mapping + frame_offset : staging.data()) + start;
+	return allocation;
+}
+
+void StreamBuffer::MarkWritten(GLintptr offset, GLsizeiptr size)
+{
+	if (persistent)
+		return;
+
+	// What lies past flushed goes up with the next Flush anyway
+	GLsizeiptr begin = offset - frame_offset;
+	GLsizeiptr end = std::min(begin + size, flushed);
+	if (end <= begin)
+		return;
+
+	if (rewritten_end <= rewritten_begin)
+	{
+		rewritten_begin = begin;
+		rewritten_end = end;
+		return;
+	}
+	rewritten_begin = std::min(rewritten_begin, begin);
+	rewritten_end = std::max(rewritten_end, end);
+}
+
+// Unsynchronized is safe for the bytes allocated since the last Flush, which
+// no draw has read and the orphaning made the frame's own. Bytes written again
+// sit next to what the earlier draws read, so they go through glBufferSubData,
+// which the driver orders after those draws.
+void StreamBuffer::Flush()
+{
+	if (persistent)
+		return;
+
+	if (rewritten_end > rewritten_begin)
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, rewritten_begin, rewritten_end - rewritten_begin, staging.data() + rewritten_begin);
+		rewritten_begin = rewritten_end = 0;
+	}
+
+	if (head == flushed)
+		return;
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT;
+	void* target = glMapBufferRange(GL_COPY_WRITE_BUFFER, flushed, head - flushed, access);
+	if (target != NULL)
+	{
+		std::memcpy(target, staging.data() + flushed, head - flushed);
+		if (glUnmapBuffer(GL_COPY_WRITE_BUFFER) == GL_TRUE)
+		{
+			flushed = head;
+			return;
+		}
+	}
+
+	glBufferSubData(GL_COPY_WRITE_BUFFER, flushed, head - flushed, staging.data() + flushed);
+	flushed = head;
+}
+
+void StreamBuffer::EndFrame()
+{
+	Flush();
+
+	if (persistent)
+		fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	statistics.bytes_last_frame = head;
+	statistics.bytes_total += head;
+	statistics.frames++;
+}
+
+void DeleteStreamBuffer(StreamBuffer& stream_buffer)
+{
+	for (GLsync& fence : stream_buffer.fences)
+	{
+		if (fence != NULL)
+			glDeleteSync(fence);
+		fence = NULL;
+	}
+
+	if (stream_buffer.mapping)
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, stream_buffer.buffer);
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+	}
+	glDeleteBuffers(1, &stream_buffer.buffer);
+	stream_buffer.staging.clear();
+
+	stream_buffer.buffer = 0;
+	stream_buffer.mapping = nullptr;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <vector>
+#include "GLM/glm.hpp"
+#include "GLAD/glad.h"
+
+/* Stream Buffer */
+
+// Frames the CPU may write ahead of the GPU: one being drawn, one queued, one
+// being written
+const int StreamBufferFrames = 3;
+
+// Regions start at multiples of this, the largest uniform buffer offset
+// alignment GL allows, so allocation alignments up to it hold in the buffer
+const GLsizeiptr StreamBufferRegionAlignment = 256;
+
+struct StreamBufferStatistics
+{
+	// Bytes allocated in the last finished frame, and in every frame so far
+	GLsizeiptr bytes_last_frame = 0;
+	GLsizeiptr bytes_total = 0;
+	size_t frames = 0;
+	// Frames that had to wait for the GPU to finish with their region
+	size_t stalls = 0;
+	// Allocations that didn't fit in what was left of their frame
+	size_t overflows = 0;
+};
+
+// Memory in a StreamBuffer for the current frame. data is written by the CPU
+// and offset is where the GPU reads it in buffer, for glBindBufferRange or an
+// attribute pointer. data is null when the frame is full.
+struct StreamAllocation
+{
+	void* data;
+	GLintptr offset;
+	GLsizeiptr size;
+};
+
+// A ring of StreamBufferFrames regions of frame_size bytes for data written
+// once a frame, such as per-draw uniforms and dynamic geometry. Allocations
+// are bumped from the current frame's region and are never freed; the region
+// is reused once the fence of the frame that last wrote it has passed.
+//
+// With ARB_buffer_storage the ring stays persistently and coherently mapped,
+// so writes need no GL call at all. Otherwise the buffer holds one frame and is
+// orphaned at the start of each, and Flush copies what was allocated since the
+// last Flush through an unsynchronized mapping.
+//
+// An allocation may be written after a Flush, where no draw issued before it
+// reads the bytes written: the persistent path sees them at once, the
+// orphaning path once they are passed to MarkWritten and flushed again.
+struct StreamBuffer
+{
+	GLuint buffer;
+	GLsizeiptr frame_size;
+	bool persistent;
+
+	// frame_size is rounded up to StreamBufferRegionAlignment. persistent
+	// false takes the orphaning path even where buffer storage is available.
+	StreamBuffer(GLsizeiptr frame_size, bool persistent = true);
+	StreamBuffer(const StreamBuffer&) = delete;
+	StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+	// Moves to the next region, waiting for the GPU if it is still reading it
+	void BeginFrame();
+
+	// size bytes at a multiple of alignment, a power of two up to
+	// StreamBufferRegionAlignment; uniform blocks need
+	// GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+	StreamAllocation Allocate(GLsizeiptr size, GLsizeiptr alignment = 16);
+
+	// Records that size bytes at offset in buffer, part of an allocation of
+	// this frame, were written after the allocation was flushed, so the next
+	// Flush uploads them again. Does nothing on the persistent path.
+	void MarkWritten(GLintptr offset, GLsizeiptr size);
+
+	// Makes every allocation so far, and the ranges marked written since the
+	// last Flush, visible to the draws issued after it. Does nothing on the
+	// persistent path.
+	void Flush();
+
+	// Flushes and fences the frame. Call after its last draw.
+	void EndFrame();
+
+	const StreamBufferStatistics& Statistics() const
+	{
+		return statistics;
+	}
+
+private:
+	char* mapping = nullptr;
+	// The frame being written on the orphaning path
+	std::vector<char> staging;
+	GLsync fences[StreamBufferFrames] = {};
+	int frame = 0;
+	GLintptr frame_offset = 0;
+	GLsizeiptr head = 0;
+	GLsizeiptr flushed = 0;
+	// Bytes below flushed written again since the last Flush, empty when the
+	// end is not past the begin
+	GLsizeiptr rewritten_begin = 0;
+	GLsizeiptr rewritten_end = 0;
+	StreamBufferStatistics statistics;
+
+	friend void DeleteStreamBuffer(StreamBuffer& stream_buffer);
+};
+
+// Waits for nothing: the buffer is deleted and GL keeps it alive for the
+// draws still reading it
+void DeleteStreamBuffer(StreamBuffer& stream_buffer);
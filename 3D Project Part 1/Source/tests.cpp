@@ -0,0 +1,781 @@
+#include "tests.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "GLM/glm.hpp"
+#include "GLM/gtc/matrix_transform.hpp"
+#include "mesh_cache.h"
+#include "mesh_generation.h"
+#include "mesh_registry.h"
+#include "mesh_streaming.h"
+#include "opengl_utilities.h"
+#include "procedural_shapes.h"
+#include "stream_buffer.h"
+#include "uniform_blocks.h"
+
+/* Tests */
+
+// Prints the outcome of one check and passes it on
+static bool Check(const std::string& name, double error, double tolerance)
+{
+	bool passed = error <= tolerance;
+	std::cout << (passed ? "Passed: " : "Failed: ") << name
+		<< ", error " << error << " (tolerance " << tolerance << ")" << std::endl;
+	return passed;
+}
+
+// The profiles with batch and GLSL versions
+static glm::dvec2(*const BuiltInProfiles[])(double) = {
+	ParametricHalfSquiggle,
+	ParametricHalfCircle,
+	ParametricCircle,
+	ParametricSpikes,
+};
+
+/* Batch Profiles */
+
+// Parameters over [-0.1, 1.1], past both ends as the sample grid halo is
+static std::vector<double> RandomParameters(size_t count)
+{
+	std::mt19937 random(405);
+	std::uniform_real_distribution<double> distribution(-0.1, 1.1);
+
+	std::vector<double> parameters(count);
+	for (auto& t : parameters)
+		t = distribution(random);
+	return parameters;
+}
+
+// Largest distance between a batch profile and the scalar function, over the
+// values and over central differences with step h, which is how the sample
+// grid turns them into normals. The scalar function is evaluated at the
+// parameters as the batch saw them, rounded to T. A difference can be no worse
+// than the two value errors over 2h, so its tolerance is value_tolerance / h.
+template <typename T>
+static bool CheckParametricLineBatch(
+	glm::dvec2(*parametric_line)(double),
+	const std::vector<double>& parameters,
+	double h,
+	double value_tolerance,
+	const char* precision
+)
+{
+	typedef glm::vec<2, T, glm::defaultp> Vector;
+	size_t count = parameters.size();
+
+	std::vector<T> t(count), before(count), after(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		t[i] = T(parameters[i]);
+		before[i] = T(parameters[i] - h);
+		after[i] = T(parameters[i] + h);
+	}
+
+	std::vector<Vector> values(count), values_before(count), values_after(count);
+	auto batch = FindParametricLineBatch<T>(parametric_line);
+	batch(t.data(), values.data(), count);
+	batch(before.data(), values_before.data(), count);
+	batch(after.data(), values_after.data(), count);
+
+	double value_error = 0, derivative_error = 0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		glm::dvec2 value = parametric_line(double(t[i]));
+		glm::dvec2 derivative = (parametric_line(double(after[i])) - parametric_line(double(before[i]))) / (double(after[i]) - double(before[i]));
+		glm::dvec2 batch_derivative = (glm::dvec2(values_after[i]) - glm::dvec2(values_before[i])) / (double(after[i]) - double(before[i]));
+
+		value_error = std::max(value_error, glm::length(glm::dvec2(values[i]) - value));
+		derivative_error = std::max(derivative_error, glm::length(batch_derivative - derivative));
+	}
+
+	std::string name = std::string(FindParametricLineName(parametric_line)) + " " + precision + " batch";
+	bool values_passed = Check(name + " values", value_error, value_tolerance);
+	bool derivatives_passed = Check(name + " derivatives", derivative_error, value_tolerance / h);
+	return values_passed && derivatives_passed;
+}
+
+// The SSE2/AVX2 kernels against the scalar profiles they replace. Double
+// batches hold to 1e-15, under 5 ulp of the unit-sized profiles; float ones to
+// 1e-6, under 10 ulp of float.
+static bool TestParametricLineBatches()
+{
+	auto parameters = RandomParameters(1 << 18);
+
+	bool passed = true;
+	for (auto parametric_line : BuiltInProfiles)
+	{
+		passed &= CheckParametricLineBatch<double>(parametric_line, parameters, 1e-3, 1e-15, "double");
+		passed &= CheckParametricLineBatch<float>(parametric_line, parameters, 1. / 512, 1e-6, "float");
+	}
+	return passed;
+}
+
+/* Float Generation */
+
+// Largest distances between the float and double meshes of a profile.
+// Vertices on the rotation axis are skipped: every direction is normal there,
+// so their normals are arbitrary in both precisions.
+static bool CheckFloatParametricShape(
+	glm::dvec2(*parametric_line)(double),
+	int segments,
+	bool squiggle,
+	double position_tolerance,
+	double normal_tolerance
+)
+{
+	ParametricSampleGrid grid;
+	FloatParametricSampleGrid float_grid;
+	std::vector<glm::vec3> positions, normals, float_positions, float_normals;
+	std::vector<GLuint> indices, float_indices;
+	GenerateParametricShapeFrom2D(positions, normals, indices, parametric_line, segments, segments, squiggle, grid);
+	GenerateParametricShapeFrom2D(float_positions, float_normals, float_indices, parametric_line, segments, segments, squiggle, float_grid);
+
+	std::string name = std::string(FindParametricLineName(parametric_line)) + (squiggle ? " squiggled " : " ")
+		+ std::to_string(segments) + "x" + std::to_string(segments) + " float";
+	if (float_positions.size() != positions.size() || float_indices != indices)
+		return Check(name + " topology", HUGE_VAL, 0);
+
+	double position_error = 0, normal_error = 0;
+	for (size_t i = 0; i < positions.size(); ++i)
+	{
+		if (glm::length(glm::vec2(positions[i].x, positions[i].z)) < 1e-3f)
+			continue;
+		position_error = std::max(position_error, double(glm::length(float_positions[i] - positions[i])));
+		normal_error = std::max(normal_error, double(glm::length(float_normals[i] - normals[i])));
+	}
+
+	bool positions_passed = Check(name + " positions", position_error, position_tolerance);
+	bool normals_passed = Check(name + " normals", normal_error, normal_tolerance);
+	return positions_passed && normals_passed;
+}
+
+// FloatParametricSampleGrid, which the scenes use, against the double grid
+// kept for export. Positions hold to 1e-6, a few float ulp of the unit-sized
+// shapes. Normals come from central differences of neighbouring samples, so
+// the float rounding is divided by the sample spacing, and most by the spikes'
+// tight turns: 2e-4 at the scenes' 160 segments, 2e-3 at 1024.
+static bool TestFloatParametricShapes()
+{
+	bool passed = true;
+	for (auto parametric_line : BuiltInProfiles)
+		for (bool squiggle : {false, true})
+		{
+			passed &= CheckFloatParametricShape(parametric_line, 160, squiggle, 1e-6, 2e-4);
+			passed &= CheckFloatParametricShape(parametric_line, 1024, squiggle, 1e-6, 2e-3);
+		}
+	return passed;
+}
+
+/* Adaptive Sampling */
+
+// The chord error of the rows and columns SubdivideParametricShapeOfRevolution
+// picks, which the halving pass holds within the tolerance unless it runs
+// into max_segments, and the segment counts between their bounds
+static bool CheckAdaptiveParametricShape(
+	const std::function<glm::dvec2(double)>& parametric_line,
+	const std::string& profile_name,
+	bool squiggle,
+	double tolerance
+)
+{
+	const int max_segments = 1024;
+	std::vector<double> profile_parameters, rotation_parameters;
+	SubdivideParametricShapeOfRevolution(parametric_line, tolerance, squiggle, max_segments, profile_parameters, rotation_parameters);
+
+	std::string name = profile_name + (squiggle ? " squiggled" : "") + " adaptive at tolerance " + std::to_string(tolerance);
+	int profile_segments = int(profile_parameters.size()) - 1;
+	int rotation_segments = int(rotation_parameters.size());
+	bool counts_passed = Check(name + " segment counts out of range",
+		double((profile_segments < 1 || profile_segments > max_segments) + (rotation_segments < 1 || rotation_segments > max_segments)), 0);
+	if (!counts_passed)
+		return false;
+
+	double error = MeasureParametricShapeOfRevolution(parametric_line, squiggle, profile_parameters, rotation_parameters);
+	return Check(name + " chord error", error, tolerance);
+}
+
+// Every built-in profile, and a straight one, the side of a cylinder, whose
+// profile has no curvature to spread the rows by. A tolerance of zero can't
+// be met and has to stop at max_segments rather than overflow.
+static bool TestAdaptiveParametricShapes()
+{
+	bool passed = true;
+	for (auto parametric_line : BuiltInProfiles)
+		for (bool squiggle : {false, true})
+			for (double tolerance : {1e-2, 1e-3})
+				passed &= CheckAdaptiveParametricShape(parametric_line, FindParametricLineName(parametric_line), squiggle, tolerance);
+
+	auto line = [](double t) { return glm::dvec2(0.5, t - 0.5); };
+	for (bool squiggle : {false, true})
+		passed &= CheckAdaptiveParametricShape(line, "line", squiggle, 1e-3);
+
+	for (double tolerance : {0., -1.})
+	{
+		std::vector<double> parameters = SubdivideParametricCurve(
+			[](double t) { return glm::dvec3(std::cos(6.283185307179586 * t), std::sin(6.283185307179586 * t), 0); },
+			tolerance, 8, 1024, true
+		);
+		passed &= Check("circle subdivided at tolerance " + std::to_string(tolerance) + " segments past 1024",
+			double(parameters.size() > 1024 || parameters.empty()), 0);
+	}
+	return passed;
+}
+
+/* Compressed Vertices */
+
+// Lambert shading of a mesh in either VertexFormat, with the light fixed so
+// the images depend on nothing but the vertices
+static const char* compressed_vertex_shader_source = R"VERTEX(
+#version 330 core
+
+layout(location = 0) in vec3 a_position;
+layout(location = 1) in vec3 a_normal;
+
+uniform vec3 u_position_scale = vec3(1);
+uniform vec3 u_position_offset = vec3(0);
+uniform mat4 u_transform;
+
+out vec3 vertex_normal;
+
+void main()
+{
+	gl_Position = u_transform * vec4(a_position * u_position_scale + u_position_offset, 1);
+	vertex_normal = mat3(u_transform) * a_normal;
+}
+)VERTEX";
+
+static const char* compressed_fragment_shader_source = R"FRAGMENT(
+#version 330 core
+
+in vec3 vertex_normal;
+
+out vec4 color;
+
+void main()
+{
+	float diffuse = max(dot(normalize(vertex_normal), normalize(vec3(0.4, 0.6, -1))), 0);
+	color = vec4(vec3(0.1 + 0.9 * diffuse), 1);
+}
+)FRAGMENT";
+
+static const UniformName UniformTestTransform("u_transform");
+
+// The mesh in the given format, drawn into the bound framebuffer and read back
+static std::vector<glm::u8vec4> RenderMesh(
+	const Program& program,
+	const std::vector<glm::vec3>& positions,
+	const std::vector<glm::vec3>& normals,
+	const std::vector<GLuint>& indices,
+	VertexFormat vertex_format,
+	GLsizei size
+)
+{
+	VAO vao(positions, normals, indices, vertex_format);
+
+	glClearColor(0, 0, 0, 1);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	BindVAO(vao, program);
+	DrawVAO(vao);
+
+	std::vector<glm::u8vec4> pixels(size_t(size) * size);
+	glReadPixels(0, 0, size, size, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+	glBindVertexArray(0);
+	DeleteVAO(vao);
+	return pixels;
+}
+
+// Renders a 160x160 scene mesh from both formats and compares the images in
+// 8-bit levels. Where an edge or a fold moves by its 1e-4 quantization a pixel
+// can flip to another surface or the background, so rather than a maximum the
+// images may differ by more than one level in at most 0.1% of the pixels, and
+// by an RMS of at most one level, which rounding the shading differently
+// comes to.
+static bool CheckCompressedMesh(
+	const Program& program,
+	glm::dvec2(*parametric_line)(double),
+	bool squiggle,
+	GLsizei size
+)
+{
+	std::vector<glm::vec3> positions, normals;
+	std::vector<GLuint> indices;
+	ParametricSampleGrid grid;
+	GenerateParametricShapeFrom2D(positions, normals, indices, parametric_line, 160, 160, squiggle, grid);
+
+	glm::mat4 transform = glm::scale(glm::mat4(1), glm::vec3(0.9f / BoundParametricShapeOfRevolution(grid)));
+	transform = glm::rotate(transform, glm::radians(30.f), glm::vec3(1, 1, 0));
+	glUseProgram(program.id);
+	program.Set(UniformTestTransform, transform);
+
+	auto float_pixels = RenderMesh(program, positions, normals, indices, VertexFormat::Float, size);
+	auto compressed_pixels = RenderMesh(program, positions, normals, indices, VertexFormat::Compressed, size);
+
+	double squared_error = 0;
+	size_t off_pixels = 0;
+	for (size_t i = 0; i < float_pixels.size(); ++i)
+	{
+		int error = 0;
+		for (int c = 0; c < 3; ++c)
+			error = std::max(error, std::abs(int(float_pixels[i][c]) - int(compressed_pixels[i][c])));
+		squared_error += double(error) * error;
+		if (error > 1)
+			++off_pixels;
+	}
+	double rms_error = std::sqrt(squared_error / float_pixels.size());
+	double off_fraction = double(off_pixels) / float_pixels.size();
+
+	std::string name = std::string(FindParametricLineName(parametric_line)) + (squiggle ? " squiggled" : "") + " compressed image";
+	bool rms_passed = Check(name + " RMS levels", rms_error, 1.);
+	bool off_passed = Check(name + " fraction of pixels off by more than 1 level", off_fraction, 0.001);
+	return rms_passed && off_passed;
+}
+
+// VertexFormat::Compressed against VertexFormat::Float on the meshes the
+// scenes draw compressed, rendered into a 512x512 framebuffer of their own
+static bool TestCompressedVertices()
+{
+	const GLsizei size = 512;
+
+	Program program = CreateProgramFromSources(compressed_vertex_shader_source, compressed_fragment_shader_source);
+	if (program.id == 0)
+		return Check("compressed image program", HUGE_VAL, 0);
+
+	GLuint framebuffer, renderbuffers[2];
+	glGenFramebuffers(1, &framebuffer);
+	glGenRenderbuffers(2, renderbuffers);
+	glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, size, size);
+	glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size, size);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+
+	bool passed = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	if (passed)
+	{
+		glViewport(0, 0, size, size);
+		glEnable(GL_DEPTH_TEST);
+		glDepthFunc(GL_LESS);
+		glDisable(GL_BLEND);
+
+		passed &= CheckCompressedMesh(program, ParametricHalfSquiggle, false, size);
+		passed &= CheckCompressedMesh(program, ParametricSpikes, false, size);
+		passed &= CheckCompressedMesh(program, ParametricSpikes, true, size);
+	}
+	else
+	{
+		Check("compressed image framebuffer", HUGE_VAL, 0);
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteRenderbuffers(2, renderbuffers);
+	glUseProgram(0);
+	glDeleteProgram(program.id);
+	return passed;
+}
+
+/* Stream Buffers */
+
+// Draws added to a DrawUniformsArray after it was flushed, as a second
+// DrawScene in a frame adds them, have to reach the buffer on both paths
+static bool CheckDrawUniformsAfterFlush(bool persistent)
+{
+	StreamBuffer stream_buffer(16 * 1024, persistent);
+	stream_buffer.BeginFrame();
+
+	DrawUniformsArray array;
+	if (!CreateDrawUniformsArray(array, stream_buffer))
+		return Check("draw uniforms array", HUGE_VAL, 0);
+
+	std::vector<DrawUniforms> draws(4);
+	for (size_t i = 0; i < draws.size(); ++i)
+		draws[i].color = glm::vec3(float(i), 0.5f, 0.25f);
+
+	// Two scenes of two draws, flushed before each is drawn
+	for (size_t i = 0; i < draws.size(); ++i)
+	{
+		AddDrawUniforms(array, draws[i]);
+		if (i % 2 == 1)
+			stream_buffer.Flush();
+	}
+
+	std::vector<DrawUniforms> uploaded(draws.size());
+	glBindBuffer(GL_COPY_READ_BUFFER, stream_buffer.buffer);
+	glGetBufferSubData(GL_COPY_READ_BUFFER, array.offset, uploaded.size() * sizeof(DrawUniforms), uploaded.data());
+
+	size_t stale_draws = 0;
+	for (size_t i = 0; i < draws.size(); ++i)
+		if (std::memcmp(&uploaded[i], &draws[i], sizeof(DrawUniforms)) != 0)
+			++stale_draws;
+
+	stream_buffer.EndFrame();
+	bool took_path = stream_buffer.persistent == persistent;
+	DeleteStreamBuffer(stream_buffer);
+
+	std::string name = std::string(persistent ? "persistent" : "orphaning") + " stream buffer draws added after a flush, stale";
+	if (!took_path)
+		std::cout << "Warning: No buffer storage, the persistent check ran on the orphaning path" << std::endl;
+	return Check(name, double(stale_draws), 0);
+}
+
+static bool TestStreamBuffers()
+{
+	bool passed = true;
+	passed &= CheckDrawUniformsAfterFlush(true);
+	passed &= CheckDrawUniformsAfterFlush(false);
+	return passed;
+}
+
+/* Mesh Registry */
+
+// Meshes with the same bytes under different keys share a VAO, and a mesh
+// differing in a single bit gets its own
+static bool TestMeshRegistry()
+{
+	std::vector<glm::vec3> positions, normals;
+	std::vector<GLuint> indices;
+	GenerateParametricShapeFrom2D(positions, normals, indices, ParametricSpikes, 16, 16, false);
+
+	MeshCacheKey key;
+	key.profile = "spikes";
+	key.vertical_segments = key.rotation_segments = 16;
+	MeshCacheKey other_key = key;
+	other_key.squiggle = true;
+	MeshCacheKey changed_key = key;
+	changed_key.vertical_segments = 17;
+
+	MeshRegistry registry;
+	auto Add = [&](const MeshCacheKey& key)
+	{
+		return registry.Add(key, VertexFormat::Float, positions.data(), normals.data(), positions.size(), indices.data(), indices.size(), 1);
+	};
+	SharedVAO vao = Add(key);
+	SharedVAO same_vao = Add(other_key);
+	normals.back().x = std::nextafter(normals.back().x, 2.f);
+	SharedVAO changed_vao = Add(changed_key);
+
+	const auto& statistics = registry.Statistics();
+	bool passed = true;
+	passed &= Check("mesh registry identical contents uploaded again", same_vao == vao ? 0 : 1, 0);
+	passed &= Check("mesh registry changed contents shared", changed_vao == vao ? 1 : 0, 0);
+	passed &= Check("mesh registry uploads beyond the 2 distinct meshes", std::abs(double(statistics.uploads) - 2), 0);
+	return passed;
+}
+
+/* Procedural Shapes */
+
+// ProceduralShapeVertexShader with its outputs captured by transform
+// feedback, so no fragment stage
+static Program CreateCaptureProgram()
+{
+	GLuint shader = CreateShaderFromSource(GL_VERTEX_SHADER, ProceduralShapeVertexShader);
+	if (shader == 0)
+		return Program();
+
+	GLuint id = glCreateProgram();
+	glAttachShader(id, shader);
+	const GLchar* varyings[] = { "vertex_position", "vertex_normal" };
+	glTransformFeedbackVaryings(id, 2, varyings, GL_INTERLEAVED_ATTRIBS);
+	glLinkProgram(id);
+	glDeleteShader(shader);
+
+	GLint success;
+	glGetProgramiv(id, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		glDeleteProgram(id);
+		id = 0;
+	}
+	return ReflectProgram(id);
+}
+
+// Largest position distance and the largest and mean angle, in degrees,
+// between the normals of the shader and of the CPU mesh at every triangle
+// corner. The draw uniforms at draw_index have to hold the identity transform
+// and the squiggle. Normals on the rotation axis are skipped: the CPU welds
+// those vertices into a pole, where every direction is normal.
+static void MeasureProceduralShape(
+	const Program& program,
+	GLsizei draw_index,
+	glm::dvec2(*parametric_line)(double),
+	int segments,
+	bool squiggle,
+	double& position_error,
+	double& max_normal_angle,
+	double& mean_normal_angle
+)
+{
+	ProceduralShape shape;
+	CreateProceduralShape(shape, parametric_line, segments, segments);
+	GLsizei vertex_count = (segments - 1) * segments * 6;
+
+	GLuint buffer;
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, buffer);
+	glBufferData(GL_TRANSFORM_FEEDBACK_BUFFER, vertex_count * 2 * sizeof(glm::vec3), nullptr, GL_STATIC_READ);
+	glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, buffer);
+
+	SelectDrawUniforms(program, draw_index);
+	glBeginTransformFeedback(GL_TRIANGLES);
+	DrawProceduralShape(shape, program);
+	glEndTransformFeedback();
+
+	// Position and normal of every corner
+	std::vector<glm::vec3> captured(size_t(vertex_count) * 2);
+	glGetBufferSubData(GL_TRANSFORM_FEEDBACK_BUFFER, 0, captured.size() * sizeof(glm::vec3), captured.data());
+	glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+	glDeleteBuffers(1, &buffer);
+	DeleteProceduralShape(shape);
+
+	ParametricSampleGrid grid;
+	std::vector<glm::vec3> positions, normals;
+	std::vector<GLuint> indices;
+	GenerateParametricShapeFrom2D(positions, normals, indices, parametric_line, segments, segments, squiggle, grid);
+
+	// The corners of a quad's two triangles, as the shader orders them
+	const int corners[6][2] = { {1, 0}, {0, 1}, {0, 0}, {1, 0}, {1, 1}, {0, 1} };
+
+	position_error = max_normal_angle = mean_normal_angle = 0;
+	size_t normal_count = 0;
+	for (GLsizei i = 0; i < vertex_count; ++i)
+	{
+		int quad = i / 6;
+		int v = quad % (segments - 1) + corners[i % 6][0];
+		int r = (quad / (segments - 1) + corners[i % 6][1]) % segments;
+		GLuint vertex = grid.layout.VertexIndex(v, r);
+
+		glm::vec3 position = captured[size_t(i) * 2];
+		glm::vec3 normal = captured[size_t(i) * 2 + 1];
+		position_error = std::max(position_error, double(glm::length(position - positions[vertex])));
+
+		glm::vec3 cpu_position = positions[vertex];
+		if (glm::length(glm::vec2(cpu_position.x, cpu_position.z)) < 1e-6f * glm::length(cpu_position))
+			continue;
+		double angle = glm::degrees(std::acos(glm::clamp(double(glm::dot(glm::normalize(normal), normals[vertex])), -1., 1.)));
+		max_normal_angle = std::max(max_normal_angle, angle);
+		mean_normal_angle += angle;
+		++normal_count;
+	}
+	if (normal_count > 0)
+		mean_normal_angle /= normal_count;
+}
+
+// The shapes the shader draws against the CPU meshes of the same grid, at
+// the 160 segments of the scenes' finest levels, to the figures measured when
+// the shader was written, rounded up in their last digit. Positions hold to
+// a few float ulp. The shader differentiates the profile exactly where the
+// CPU takes central differences of the samples: within 0.03 degrees for the
+// circles and 0.07 for the half squiggle, 0.27 once squiggled. The spikes'
+// cusps turn too fast for the samples, so only their mean is held, to 2.5.
+static bool TestProceduralShapes()
+{
+	const int segments = 160;
+
+	Program program = CreateCaptureProgram();
+	if (program.id == 0 || !BindUniformBlocks(program))
+		return Check("procedural shape capture program", HUGE_VAL, 0);
+
+	StreamBuffer stream_buffer(16 * 1024);
+	stream_buffer.BeginFrame();
+	DrawUniformsArray array;
+	CreateDrawUniformsArray(array, stream_buffer);
+
+	// Without the squiggle and with the generators' default one
+	ParametricSquiggle squiggle;
+	DrawUniforms draws[2];
+	draws[1].squiggle = glm::vec4(float(squiggle.frequency), float(squiggle.amplitude), float(squiggle.phase), float(squiggle.scale));
+	GLsizei draw_indices[2] = { AddDrawUniforms(array, draws[0]), AddDrawUniforms(array, draws[1]) };
+	stream_buffer.Flush();
+	BindDrawUniforms(array);
+
+	glUseProgram(program.id);
+	glEnable(GL_RASTERIZER_DISCARD);
+
+	bool passed = true;
+	for (auto parametric_line : BuiltInProfiles)
+		for (bool squiggle : {false, true})
+		{
+			double position_error, max_normal_angle, mean_normal_angle;
+			MeasureProceduralShape(program, draw_indices[squiggle], parametric_line, segments, squiggle, position_error, max_normal_angle, mean_normal_angle);
+
+			std::string name = std::string(FindParametricLineName(parametric_line)) + (squiggle ? " squiggled " : " ")
+				+ std::to_string(segments) + "x" + std::to_string(segments) + " procedural";
+			passed &= Check(name + " positions", position_error, 3e-6);
+			if (parametric_line == ParametricSpikes)
+				passed &= Check(name + " mean normal degrees", mean_normal_angle, 2.6);
+			else if (parametric_line == ParametricHalfSquiggle)
+				passed &= Check(name + " normal degrees", max_normal_angle, squiggle ? 0.28 : 0.08);
+			else
+				passed &= Check(name + " normal degrees", max_normal_angle, 0.04);
+		}
+
+	glDisable(GL_RASTERIZER_DISCARD);
+	glUseProgram(0);
+	glDeleteProgram(program.id);
+	stream_buffer.EndFrame();
+	DeleteStreamBuffer(stream_buffer);
+	return passed;
+}
+
+/* Streaming Generation */
+
+// Every byte of a GL buffer
+static std::vector<char> ReadBuffer(GLuint buffer)
+{
+	glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+	GLint size = 0;
+	glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_SIZE, &size);
+	std::vector<char> data(size);
+	glGetBufferSubData(GL_COPY_READ_BUFFER, 0, size, data.data());
+	return data;
+}
+
+// Streams the mesh of grid's last GenerateParametricShapeFrom2D in tiles of
+// tile_vertex_count vertices through three sinks: one rebuilding it in
+// memory from each tile's offsets, CreateVAOSink and CreateMeshCacheSink.
+// The tiles run the same builders over the same samples, so each has to
+// match the generated mesh exactly.
+static bool CheckStreamedParametricShape(
+	glm::dvec2(*parametric_line)(double),
+	int segments,
+	bool squiggle,
+	ParametricSampleGrid& grid,
+	const std::vector<glm::vec3>& positions,
+	const std::vector<glm::vec3>& normals,
+	const std::vector<GLuint>& indices,
+	size_t tile_vertex_count
+)
+{
+	std::string name = std::string(FindParametricLineName(parametric_line)) + (squiggle ? " squiggled " : " ")
+		+ std::to_string(segments) + "x" + std::to_string(segments) + " streamed in tiles of " + std::to_string(tile_vertex_count);
+	ParametricShapeOptions options;
+	options.tile_vertex_count = tile_vertex_count;
+
+	// Tiles have to follow each other, hold whole columns, never more than
+	// tile_vertex_count vertices unless one column is more, and end with the
+	// only last tile
+	std::vector<glm::vec3> streamed_positions, streamed_normals;
+	std::vector<GLuint> streamed_indices;
+	uint64_t next_vertex = 0, next_index = 0;
+	bool ended = false;
+	size_t misplaced_tiles = 0;
+	uint64_t ring_rows = grid.layout.ring_rows;
+	auto Rebuild = [&](const ParametricMeshTile& tile)
+	{
+		bool whole_columns = tile.last || (tile.vertex_count % ring_rows == 0 && tile.vertex_count <= std::max<uint64_t>(tile_vertex_count, ring_rows));
+		if (tile.first_vertex != next_vertex || tile.first_index != next_index || ended || !whole_columns)
+			++misplaced_tiles;
+		ended = tile.last;
+		next_vertex = tile.first_vertex + tile.vertex_count;
+		next_index = tile.first_index + tile.index_count;
+		if (next_vertex > tile.total_vertex_count || next_index > tile.total_index_count)
+			return false;
+
+		streamed_positions.resize(size_t(tile.total_vertex_count));
+		streamed_normals.resize(size_t(tile.total_vertex_count));
+		streamed_indices.resize(size_t(tile.total_index_count));
+		std::copy(tile.positions, tile.positions + size_t(tile.vertex_count), streamed_positions.begin() + size_t(tile.first_vertex));
+		std::copy(tile.normals, tile.normals + size_t(tile.vertex_count), streamed_normals.begin() + size_t(tile.first_vertex));
+		for (size_t i = 0; i < tile.index_count; ++i)
+			streamed_indices[size_t(tile.first_index) + i] = GLuint(tile.indices[i]);
+		return true;
+	};
+	bool completed = StreamParametricShapeFrom2D(grid, parametric_line, segments, segments, squiggle, ParametricMeshSink(Rebuild), options);
+	if (!completed || !ended || next_vertex != positions.size() || next_index != indices.size())
+		++misplaced_tiles;
+
+	size_t differences = 0;
+	if (streamed_positions != positions || streamed_normals != normals || streamed_indices != indices)
+		differences = std::max(streamed_positions.size(), positions.size()) + std::max(streamed_indices.size(), indices.size());
+
+	// The VAO's buffers against those of a VAO made from the whole mesh
+	SharedVAO vao;
+	size_t vao_differences = 0;
+	if (StreamParametricShapeFrom2D(grid, parametric_line, segments, segments, squiggle, CreateVAOSink(vao), options) && vao)
+	{
+		VAO generated_vao(positions, normals, indices);
+		for (size_t i = 0; i < generated_vao.vertex_buffers.size(); ++i)
+			vao_differences += ReadBuffer(vao->vertex_buffers[i]) != ReadBuffer(generated_vao.vertex_buffers[i]);
+		vao_differences += ReadBuffer(vao->element_array_buffer) != ReadBuffer(generated_vao.element_array_buffer);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		DeleteVAO(generated_vao);
+	}
+	else
+		vao_differences = 1;
+
+	// The cache file, mapped back; the streamed key is never written by the
+	// scenes, so the test file is removed again
+	MeshCacheKey key;
+	key.profile = FindParametricLineName(parametric_line);
+	key.vertical_segments = key.rotation_segments = segments;
+	key.squiggle = squiggle;
+	key.double_precision = true;
+	key.streamed = true;
+	size_t cache_differences = 1;
+	if (StreamParametricShapeFrom2D(grid, parametric_line, segments, segments, squiggle, CreateMeshCacheSink(key), options))
+	{
+		MappedMeshFile file;
+		if (file.Open(key) && file.vertex_count == positions.size() && file.index_count == indices.size())
+			cache_differences = !std::equal(positions.begin(), positions.end(), file.positions)
+				+ !std::equal(normals.begin(), normals.end(), file.normals)
+				+ !std::equal(indices.begin(), indices.end(), file.indices);
+		file.Close();
+		std::remove((std::string(MeshCacheDirectory) + "/" + key.Name() + ".mesh").c_str());
+	}
+
+	bool passed = true;
+	passed &= Check(name + " tiles out of place", double(misplaced_tiles), 0);
+	passed &= Check(name + " rebuilt from the tiles", double(differences), 0);
+	passed &= Check(name + " VAO buffers", double(vao_differences), 0);
+	passed &= Check(name + " cache file arrays", double(cache_differences), 0);
+	return passed;
+}
+
+// Tile sizes around the column boundaries: below one column, which still
+// streams a column per tile, exactly one, a count of columns that leaves a
+// short last tile, one that splits them evenly plus a vertex that rounds
+// away, and the whole mesh in a tile
+static bool TestStreamedParametricShapes()
+{
+	const int segments = 20;
+	bool passed = true;
+	for (auto parametric_line : { ParametricSpikes, ParametricCircle })
+		for (bool squiggle : {false, true})
+		{
+			ParametricSampleGrid grid;
+			std::vector<glm::vec3> positions, normals;
+			std::vector<GLuint> indices;
+			GenerateParametricShapeFrom2D(positions, normals, indices, parametric_line, segments, segments, squiggle, grid);
+
+			size_t ring_rows = grid.layout.ring_rows;
+			for (size_t tile_vertex_count : { size_t(1), ring_rows - 1, ring_rows, ring_rows * 3, ring_rows * 5 + 1, positions.size() })
+				passed &= CheckStreamedParametricShape(parametric_line, segments, squiggle, grid, positions, normals, indices, tile_vertex_count);
+		}
+	return passed;
+}
+
+bool RunTests()
+{
+	bool passed = true;
+	passed &= TestParametricLineBatches();
+	passed &= TestFloatParametricShapes();
+	passed &= TestAdaptiveParametricShapes();
+	passed &= TestCompressedVertices();
+	passed &= TestStreamBuffers();
+	passed &= TestMeshRegistry();
+	passed &= TestStreamedParametricShapes();
+	passed &= TestProceduralShapes();
+
+	std::cout << (passed ? "All tests passed" : "Some tests failed") << std::endl;
+	return passed;
+}
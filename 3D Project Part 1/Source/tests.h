@@ -0,0 +1,10 @@
+#pragma once
+
+/* Tests */
+
+// Accuracy checks with explicit tolerances, run by starting the program with
+// --test. Each check prints "Passed: " or "Failed: " with the error it
+// measured and the tolerance it was held to; RunTests returns false when any
+// check failed, and the program then exits with 1. Needs the program's GL
+// context to be current.
+bool RunTests();
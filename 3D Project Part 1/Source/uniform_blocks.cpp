@@ -0,0 +1,155 @@
+#include "uniform_blocks.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+/* Uniform Blocks */
+
+struct UniformBlockMember
+{
+	const char* name;
+	size_t offset;
+};
+
+static const UniformBlockMember FrameUniformsMembers[] = {
+	{ "u_mouse_position", offsetof(FrameUniforms, mouse_position) },
+	{ "u_light_direction", offsetof(FrameUniforms, light_direction) },
+	{ "u_light_color", offsetof(FrameUniforms, light_color) },
+	{ "u_ambient_color", offsetof(FrameUniforms, ambient_color) },
+};
+
+// The second element checks the array stride
+static const UniformBlockMember DrawUniformsMembers[] = {
+	{ "u_draws[0].transform", offsetof(DrawUniforms, transform) },
+	{ "u_draws[0].squiggle", offsetof(DrawUniforms, squiggle) },
+	{ "u_draws[0].position_scale", offsetof(DrawUniforms, position_scale) },
+	{ "u_draws[0].position_offset", offsetof(DrawUniforms, position_offset) },
+	{ "u_draws[0].color", offsetof(DrawUniforms, color) },
+	{ "u_draws[0].shininess", offsetof(DrawUniforms, shininess) },
+	{ "u_draws[1].transform", sizeof(DrawUniforms) + offsetof(DrawUniforms, transform) },
+};
+
+static const UniformName UniformDraw("u_draw");
+
+std::string WithUniformBlocks(const GLchar* source)
+{
+	std::string result(source);
+	auto version = result.find("#version");
+	auto line_end = version == std::string::npos ? std::string::npos : result.find('\n', version);
+	if (line_end == std::string::npos)
+		return UniformBlocksSource + result;
+
+	result.insert(line_end + 1, UniformBlocksSource);
+	return result;
+}
+
+// A program that doesn't use a block has no index for it, which is fine. std140
+// keeps every member of a block active, so all of them are reported.
+static bool BindUniformBlock(
+	const Program& program,
+	const char* block_name,
+	GLuint binding,
+	GLint size,
+	const UniformBlockMember* members,
+	size_t member_count
+)
+{
+	GLuint block_index = glGetUniformBlockIndex(program.id, block_name);
+	if (block_index == GL_INVALID_INDEX)
+		return true;
+
+	glUniformBlockBinding(program.id, block_index, binding);
+
+	bool matches = true;
+	GLint data_size = 0;
+	glGetActiveUniformBlockiv(program.id, block_index, GL_UNIFORM_BLOCK_DATA_SIZE, &data_size);
+	if (data_size != size)
+	{
+		std::cout << "Error: Uniform block " << block_name << " is " << data_size << " bytes, its C++ mirror " << size << std::endl;
+		matches = false;
+	}
+
+	for (size_t i = 0; i < member_count; ++i)
+	{
+		const ProgramVariable* found = nullptr;
+		for (const auto& uniform : program.uniforms)
+			if (uniform.block_index == GLint(block_index) && uniform.name == members[i].name)
+				found = &uniform;
+
+		if (found == nullptr || found->offset != GLint(members[i].offset))
+		{
+			std::cout << "Error: Uniform block member " << members[i].name << " is at "
+				<< (found ? found->offset : -1) << ", its C++ mirror at " << members[i].offset << std::endl;
+			matches = false;
+		}
+	}
+	return matches;
+}
+
+bool BindUniformBlocks(const Program& program)
+{
+	bool frame = BindUniformBlock(program, "FrameUniforms", FrameUniformsBinding, sizeof(FrameUniforms),
+		FrameUniformsMembers, sizeof(FrameUniformsMembers) / sizeof(*FrameUniformsMembers));
+	bool draw = BindUniformBlock(program, "DrawUniforms", DrawUniformsBinding, sizeof(DrawUniforms) * DrawUniformsCapacity,
+		DrawUniformsMembers, sizeof(DrawUniformsMembers) / sizeof(*DrawUniformsMembers));
+	return frame && draw;
+}
+
+// Queried once, the first time a block is allocated; it is fixed for the context
+static GLsizeiptr UniformBufferAlignment()
+{
+	static const GLsizeiptr alignment = []()
+	{
+		GLint value = 0;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &value);
+		return std::max<GLsizeiptr>(value, 16);
+	}();
+	return alignment;
+}
+
+bool BindFrameUniforms(StreamBuffer& stream_buffer, const FrameUniforms& frame)
+{
+	auto allocation = stream_buffer.Allocate(sizeof(FrameUniforms), UniformBufferAlignment());
+	if (allocation.data == nullptr)
+		return false;
+
+	std::memcpy(allocation.data, &frame, sizeof(frame));
+	stream_buffer.Flush();
+	glBindBufferRange(GL_UNIFORM_BUFFER, FrameUniformsBinding, stream_buffer.buffer, allocation.offset, sizeof(FrameUniforms));
+	return true;
+}
+
+bool CreateDrawUniformsArray(DrawUniformsArray& array, StreamBuffer& stream_buffer)
+{
+	array = DrawUniformsArray();
+	auto allocation = stream_buffer.Allocate(sizeof(DrawUniforms) * DrawUniformsCapacity, UniformBufferAlignment());
+	if (allocation.data == nullptr)
+		return false;
+
+	array.stream_buffer = &stream_buffer;
+	array.buffer = stream_buffer.buffer;
+	array.offset = allocation.offset;
+	array.data = static_cast<DrawUniforms *>(allocation.data);
+	return true;
+}
+
+GLsizei AddDrawUniforms(DrawUniformsArray& array, const DrawUniforms& draw)
+{
+	if (array.data == nullptr || array.count == DrawUniformsCapacity)
+		return -1;
+
+	std::memcpy(array.data + array.count, &draw, sizeof(draw));
+	array.stream_buffer->MarkWritten(array.offset + array.count * sizeof(DrawUniforms), sizeof(DrawUniforms));
+	return array.count++;
+}
+
+void BindDrawUniforms(const DrawUniformsArray& array)
+{
+	glBindBufferRange(GL_UNIFORM_BUFFER, DrawUniformsBinding, array.buffer, array.offset, sizeof(DrawUniforms) * DrawUniformsCapacity);
+}
+
+void SelectDrawUniforms(const Program& program, GLsizei index)
+{
+	program.Set(UniformDraw, GLint(index));
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include "GLM/glm.hpp"
+#include "GLAD/glad.h"
+#include "opengl_utilities.h"
+#include "stream_buffer.h"
+
+/* Uniform Blocks */
+
+// Elements of the DrawUniforms array, the most draws a frame can make. 8 KiB,
+// half the smallest GL_MAX_UNIFORM_BLOCK_SIZE. A macro as well, so the GLSL
+// array is sized from the same number.
+#define UNIFORM_BLOCKS_DRAW_CAPACITY 64
+#define UNIFORM_BLOCKS_STRING(x) UNIFORM_BLOCKS_STRING_EXPANDED(x)
+#define UNIFORM_BLOCKS_STRING_EXPANDED(x) #x
+
+const GLsizei DrawUniformsCapacity = UNIFORM_BLOCKS_DRAW_CAPACITY;
+
+// The data every program reads, as two std140 blocks: what stays the same
+// for a whole frame, and an array with an element for every draw of the
+// frame. Both are written and bound once a frame; a draw only sets u_draw,
+// the index of its element. The defines let shaders use the members of the
+// frame block and of the draw's element as plain uniforms.
+//
+// Every stage of every program declares both blocks through
+// UniformBlocksSource, as blocks of the same name have to match across stages.
+const GLchar* const UniformBlocksSource =
+"\n#define DRAW_UNIFORMS_CAPACITY " UNIFORM_BLOCKS_STRING(UNIFORM_BLOCKS_DRAW_CAPACITY) R"BLOCKS(
+
+layout(std140) uniform FrameUniforms
+{
+	vec2 u_mouse_position;
+	vec3 u_light_direction;
+	vec3 u_light_color;
+	vec3 u_ambient_color;
+};
+
+struct DrawData
+{
+	mat4 transform;
+	vec4 squiggle;
+	vec3 position_scale;
+	vec3 position_offset;
+	vec3 color;
+	float shininess;
+};
+
+layout(std140) uniform DrawUniforms
+{
+	DrawData u_draws[DRAW_UNIFORMS_CAPACITY];
+};
+
+uniform int u_draw;
+
+#define u_transform u_draws[u_draw].transform
+#define u_squiggle u_draws[u_draw].squiggle
+#define u_position_scale u_draws[u_draw].position_scale
+#define u_position_offset u_draws[u_draw].position_offset
+#define u_color u_draws[u_draw].color
+#define u_shininess u_draws[u_draw].shininess
+)BLOCKS";
+
+const GLuint FrameUniformsBinding = 0;
+const GLuint DrawUniformsBinding = 1;
+
+// C++ mirrors of the blocks. std140 puts a vec3 on 16 bytes but lets a
+// scalar take the 4 after it, hence the padding. The static_asserts keep the
+// offsets in step with the GLSL, and BindUniformBlocks checks them against
+// what the linker reports.
+struct FrameUniforms
+{
+	glm::vec2 mouse_position = glm::vec2(0);
+	glm::vec2 padding0 = glm::vec2(0);
+	glm::vec3 light_direction = glm::vec3(0, 0, 1);
+	float padding1 = 0;
+	glm::vec3 light_color = glm::vec3(0);
+	float padding2 = 0;
+	glm::vec3 ambient_color = glm::vec3(0);
+	float padding3 = 0;
+};
+
+static_assert(offsetof(FrameUniforms, mouse_position) == 0, "FrameUniforms must follow the std140 layout of the GLSL block");
+static_assert(offsetof(FrameUniforms, light_direction) == 16, "FrameUniforms must follow the std140 layout of the GLSL block");
+static_assert(offsetof(FrameUniforms, light_color) == 32, "FrameUniforms must follow the std140 layout of the GLSL block");
+static_assert(offsetof(FrameUniforms, ambient_color) == 48, "FrameUniforms must follow the std140 layout of the GLSL block");
+static_assert(sizeof(FrameUniforms) == 64, "FrameUniforms must follow the std140 layout of the GLSL block");
+
+// An element of the u_draws array. std140 rounds the struct up to 16 bytes,
+// which 128 already is, so the array stride is its size. The defaults draw a
+// mesh as it was uploaded: no squiggle, float positions.
+struct DrawUniforms
+{
+	glm::mat4 transform = glm::mat4(1);
+	glm::vec4 squiggle = glm::vec4(0, 0, 0, 1);
+	glm::vec3 position_scale = glm::vec3(1);
+	float padding0 = 0;
+	glm::vec3 position_offset = glm::vec3(0);
+	float padding1 = 0;
+	glm::vec3 color = glm::vec3(1);
+	float shininess = 1;
+};
+
+static_assert(offsetof(DrawUniforms, transform) == 0, "DrawUniforms must follow the std140 layout of the GLSL block");
+static_assert(offsetof(DrawUniforms, squiggle) == 64, "DrawUniforms must follow the std140 layout of the GLSL block");
+static_assert(offsetof(DrawUniforms, position_scale) == 80, "DrawUniforms must follow the std140 layout of the GLSL block");
+static_assert(offsetof(DrawUniforms, position_offset) == 96, "DrawUniforms must follow the std140 layout of the GLSL block");
+static_assert(offsetof(DrawUniforms, color) == 112, "DrawUniforms must follow the std140 layout of the GLSL block");
+static_assert(offsetof(DrawUniforms, shininess) == 124, "DrawUniforms must follow the std140 layout of the GLSL block");
+static_assert(sizeof(DrawUniforms) == 128, "DrawUniforms must follow the std140 layout of the GLSL block");
+
+// source with UniformBlocksSource inserted after its #version line
+std::string WithUniformBlocks(const GLchar* source);
+
+// Points the program's blocks at FrameUniformsBinding and DrawUniformsBinding
+// and checks their offsets and sizes against the C++ mirrors. False, with the
+// mismatch on the console, when they disagree.
+bool BindUniformBlocks(const Program& program);
+
+// Writes frame into stream_buffer and binds it for the rest of the frame.
+// False when the frame's region is full.
+bool BindFrameUniforms(StreamBuffer& stream_buffer, const FrameUniforms& frame);
+
+// The per-draw uniforms of a frame: one StreamBuffer allocation holding the
+// whole u_draws array
+struct DrawUniformsArray
+{
+	StreamBuffer* stream_buffer = nullptr;
+	GLuint buffer = 0;
+	GLintptr offset = 0;
+	DrawUniforms* data = nullptr;
+	GLsizei count = 0;
+};
+
+// Allocates the DrawUniformsCapacity elements from stream_buffer. False when
+// the frame's region is full.
+bool CreateDrawUniformsArray(DrawUniformsArray& array, StreamBuffer& stream_buffer);
+
+// Appends a draw and returns its index, or -1 when the array is full. Draws
+// may be added after the array was flushed and drawn from; they are marked
+// written, so the next flush uploads them.
+GLsizei AddDrawUniforms(DrawUniformsArray& array, const DrawUniforms& draw);
+
+// Binds the whole array to DrawUniformsBinding. The stream buffer has to be
+// flushed after the last AddDrawUniforms the draws depend on.
+void BindDrawUniforms(const DrawUniformsArray& array);
+
+// Makes the program in use read the element at index, for the draws until the
+// next call
+void SelectDrawUniforms(const Program& program, GLsizei index);